@@ -0,0 +1,79 @@
+// The purpose of this file is to compare binary and d-ary heaps as the certificate queue of a kinetic structure.
+
+#include "min_heap.h"
+#include "heap.h"
+#include <iostream>
+#include <random>
+#include <time.h>
+
+// Replays the access pattern of a kinetic event loop: pop the earliest certificate,
+// invalidate a few neighbouring ones and schedule a few new ones later in time.
+template<size_t Arity>
+double run(size_t slots, size_t events) {
+    RefTable table(slots + 1);
+    MinHeap<double, size_t, false, RefTable, std::less<double>, Arity> certificates(&table);
+    std::mt19937 gen(2021);
+    std::uniform_real_distribution<double> later(0, 1000);
+
+    for (size_t slot = 1; slot <= slots; ++slot)
+        certificates.vec.push_back({later(gen), slot});
+    certificates.heapify();
+    certificates.relink();
+
+    clock_t start = clock();
+    for (size_t e = 0; e < events; ++e) {
+        double now = certificates.min().value();
+        size_t slot = certificates.min_ref_index().value();
+        certificates.remove_min();
+        for (int k = 0; k < 4; ++k) {
+            size_t other = 1 + gen() % slots;
+            certificates.remove(table.index[other]);
+        }
+        for (size_t other : {slot, 1 + gen() % slots, 1 + gen() % slots, 1 + gen() % slots}) {
+            if (table.index[other] == 0)
+                certificates.add(now + later(gen), other);
+        }
+    }
+    clock_t end = clock();
+    return (end - start) * 1.0 / CLOCKS_PER_SEC * 1000;
+}
+
+// Times a whole KineticHeap moving objects over 2000 unit steps, with rebuilds turned off so that every
+// certificate failure goes through the event queue. Returns the number of events in processed.
+template<size_t Arity>
+double run_kinetic(size_t objects, size_t& processed) {
+    std::mt19937 gen(2021);
+    std::uniform_int_distribution<int> position(-1000000, 1000000), velocity(-1000, 1000);
+    std::vector<MovingObject<int>> items;
+    for (size_t i = 0; i < objects; ++i)
+        items.push_back(MovingObject<int>(position(gen), velocity(gen), i));
+    KineticHeap<int, Arity> heap(items);
+    heap.rebuild_factor = std::numeric_limits<double>::infinity();
+
+    clock_t start = clock();
+    for (int step = 0; step < 2000; ++step)
+        heap.fastforward(1);
+    clock_t end = clock();
+    processed = heap.events_processed;
+    return (end - start) * 1.0 / CLOCKS_PER_SEC * 1000;
+}
+
+int main(int argc, char** argv) {
+    const size_t events = 2000000;
+    for (size_t slots : {1000, 100000, 4000000}) {
+        std::cout << slots << " certificates, " << events << " events" << std::endl;
+        std::cout << "  [Binary heap] time: " << run<2>(slots, events) << "ms" << std::endl;
+        std::cout << "  [4-ary heap] time: " << run<4>(slots, events) << "ms" << std::endl;
+        std::cout << "  [8-ary heap] time: " << run<8>(slots, events) << "ms" << std::endl;
+    }
+    for (size_t objects : {100000, 2000000}) {
+        size_t processed = 0;
+        double binary = run_kinetic<2>(objects, processed);
+        double four = run_kinetic<4>(objects, processed);
+        double eight = run_kinetic<8>(objects, processed);
+        std::cout << "KineticHeap, " << objects << " objects, " << processed << " events" << std::endl;
+        std::cout << "  [Binary heap] time: " << binary << "ms" << std::endl;
+        std::cout << "  [4-ary heap] time: " << four << "ms" << std::endl;
+        std::cout << "  [8-ary heap] time: " << eight << "ms" << std::endl;
+    }
+}
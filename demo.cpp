@@ -29,8 +29,8 @@ int main() {
 	KineticSuccessor<int> succ(v, &time);
 	for (int i = 0; i < 8; i++) {
 		succ.fastforward(1);
-		for (auto j : succ.items) {
-			cout << j.value << ' ';
+		for (int j = 0; j < succ.items.size(); j++) {
+			cout << succ.at(j).value << ' ';
 		}
 		cout << endl;
 	}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include "trajectory.h"
+
+// The lower envelope of a fixed set of trajectories, which is the min at every time at once.
+// Since trajectories are lines, the envelope is a chain of them ordered by decreasing slope,
+// and the min changes exactly at the crossings of consecutive lines on the chain.
+// Building costs O(n log n), and then the min at any time costs O(log n) without any events.
+template<typename T>
+struct KineticEnvelope {
+#ifdef __SIZEOF_INT128__
+    using Wide = __int128;
+#else
+    using Wide = long double;
+#endif
+
+    // Trajectory and payload of each handle. Handles start at 1, so 0 can mean "none".
+    std::vector<Trajectory> items;
+    std::vector<T> values;
+    // Handles of the lines on the envelope, in the order they become the min as time goes on
+    std::vector<uint32_t> hull;
+    // Position on hull of the last sweep_min_at query
+    size_t cursor = 0;
+
+    // The item at index i of items_ gets handle i + 1.
+    KineticEnvelope(const std::vector<MovingObject<T> >& items_) : items(items_.size() + 1), values(items_.size() + 1) {
+        std::vector<uint32_t> order;
+        for (size_t i = 0; i < items_.size(); ++i) {
+            items[i + 1] = items_[i].trajectory(i + 1);
+            values[i + 1] = items_[i].value;
+            order.push_back(i + 1);
+        }
+
+        // Steepest first, and among parallel lines only the lowest can be on the envelope
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            const Trajectory &x = items[a], &y = items[b];
+            if (x.slope != y.slope)
+                return x.slope > y.slope;
+            if (x.intercept != y.intercept)
+                return x.intercept < y.intercept;
+            return x.id < y.id;
+        });
+        for (uint32_t handle : order) {
+            if (!hull.empty() && items[hull.back()].slope == items[handle].slope)
+                continue;
+            while (hull.size() >= 2 && hidden(items[hull[hull.size() - 2]], items[hull.back()], items[handle]))
+                hull.pop_back();
+            hull.push_back(handle);
+        }
+    }
+
+    size_t size() const {
+        return items.size() - 1;
+    }
+
+    // Whether b is never strictly below both a and c, for slopes a > b > c.
+    // That's when c overtakes a no later than b does.
+    static bool hidden(const Trajectory &a, const Trajectory &b, const Trajectory &c) {
+        return static_cast<Wide>(static_cast<int64_t>(c.intercept) - a.intercept) * (static_cast<int64_t>(a.slope) - b.slope)
+            <= static_cast<Wide>(static_cast<int64_t>(b.intercept) - a.intercept) * (static_cast<int64_t>(a.slope) - c.slope);
+    }
+
+    // Whether hull line k + 1 has taken over from hull line k by time t. Ties go to the flatter line,
+    // which is the one that's lower just after t, like PositionAt.
+    bool taken_over(size_t k, int t) const {
+        const Trajectory &a = items[hull[k]], &b = items[hull[k + 1]];
+        return b.intercept + static_cast<int64_t>(b.slope) * t <= a.intercept + static_cast<int64_t>(a.slope) * t;
+    }
+
+    // Position on hull of the min at time t, in O(log n)
+    size_t hull_index_at(int t) const {
+        // taken_over is true for a prefix of the hull and false after it, since the crossings are increasing.
+        size_t low = 0, high = hull.size() - 1;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (taken_over(mid, t))
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    // Handle of the object with the lowest position at time t, in O(log n)
+    std::optional<size_t> min_handle_at(int t) const {
+        return !hull.empty() ? std::make_optional<size_t>(hull[hull_index_at(t)]) : std::nullopt;
+    }
+
+    // Same as min_handle_at, but walks from the previous query, which is O(1) amortized
+    // over queries at non-decreasing times.
+    std::optional<size_t> sweep_min_handle_at(int t) {
+        if (hull.empty())
+            return std::nullopt;
+        // Time went backwards
+        if (cursor > 0 && !taken_over(cursor - 1, t))
+            cursor = hull_index_at(t);
+        while (cursor + 1 < hull.size() && taken_over(cursor, t))
+            ++cursor;
+        return hull[cursor];
+    }
+
+    // Gets the object with the given handle. Its initialPosition is its position at time 0.
+    MovingObject<T> get(size_t handle) const {
+        return MovingObject<T>(items[handle].intercept, items[handle].slope, values[handle]);
+    }
+
+    // The object with the lowest position at time t, in O(log n)
+    std::optional<MovingObject<T>> min_at(int t) const {
+        std::optional<size_t> handle = min_handle_at(t);
+        return handle ? std::make_optional(get(*handle)) : std::nullopt;
+    }
+
+    std::optional<MovingObject<T>> sweep_min_at(int t) {
+        std::optional<size_t> handle = sweep_min_handle_at(t);
+        return handle ? std::make_optional(get(*handle)) : std::nullopt;
+    }
+
+    // Lowest position at time t
+    std::optional<int> min_position_at(int t) const {
+        std::optional<size_t> handle = min_handle_at(t);
+        return handle ? std::make_optional(items[*handle].position(t)) : std::nullopt;
+    }
+};
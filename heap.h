@@ -1,39 +1,117 @@
+#pragma once
+
 #include <vector>
 #include <utility>
 #include <optional>
 #include <ostream>
 #include <iostream>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include "min_heap.h"
 #include "successor.h"
-
-template<typename T, typename Ref, bool Standalone = false>
-struct MinHeap {
-    struct Element {
-        T t;
-        // Index to the element to reference in the ref.
-        // If this is 0, then no element gets referenced.
-        // Also, not using pointers because vector pointers get invalidated on reallocation
-        size_t ref_index;
+#include "parallel.h"
+
+// CertificateArity is the arity of the event queue, which every event hits. The default of 4 comes from
+// cert_queue_benchmark_output.txt: a binary queue is 5-8% faster while the queue fits in cache, but 4-ary
+// and 8-ary ones are about twice as fast once it doesn't, and 4 is the fastest whole KineticHeap at 2M objects.
+// Coord is the type of positions, velocities and time. With integer coordinates certificates fail at
+// exact fractions, see CoordinateTraits.
+template<typename T, size_t CertificateArity = 4, typename Coord = int>
+struct KineticHeap {
+    using Traits = CoordinateTraits<Coord>;
+    using Failure = typename Traits::Failure;
+    using Item = BasicTrajectory<Coord>;
+
+    // A node of the binary heap of items. The event of the certificate comparing the node's item with
+    // its parent's is linked inline, so an event only touches the nodes it swaps and their neighbours.
+    // With int coordinates a node is 16 bytes, four to a cache line.
+    struct Node {
+        // The id of the item is its handle.
+        Item item;
+        // Index of this node's certificate in events, or in rewinds with rewind_tag set, or 0 if it has none
+        uint32_t event;
     };
 
-    std::vector<Element> vec;
-    // The structure to reference.
-    MinHeap<Ref, T, Standalone>* ref;
+    static constexpr uint32_t rewind_tag = uint32_t(1) << 31;
 
-    // Add element to simplify parent-child math
-    MinHeap(MinHeap<Ref, T, Standalone>* ref_) : vec(1), ref(ref_) {}
+    // Keeps each node's event index up to date as an event queue moves its elements around
+    struct EventLinks {
+        std::vector<Node, CacheAlignedAllocator<Node> >* nodes;
+        uint32_t tag;
 
-    static constexpr size_t root() {
-        return 1;
+        void set_ref_index(size_t node, size_t index) {
+            if (node != 0)
+                (*nodes)[node].event = index != 0 ? static_cast<uint32_t>(index) | tag : 0;
+        }
+    };
+
+    // nodes[0] is unused to simplify parent-child math, like in MinHeap.
+    std::vector<Node, CacheAlignedAllocator<Node> > nodes;
+    EventLinks event_links;
+    EventLinks rewind_links;
+    // Certificate failure times keyed by node index. Certificates belong to positions in the heap,
+    // so swapping two items never moves an event.
+    MinHeap<Failure, size_t, false, EventLinks, std::less<Failure>, CertificateArity, uint32_t> events;
+    // Certificates of the pairs that are moving apart, which fail going back in time, latest first.
+    // Only kept when reversible is set.
+    MinHeap<Failure, size_t, false, EventLinks, std::greater<Failure>, CertificateArity, uint32_t> rewinds;
+    // Node holding the item for each handle. Handles start at 1, so 0 can mean "none".
+    std::vector<size_t> node_of;
+    std::vector<size_t> free_handles;
+    // Payload of each handle
+    std::vector<T> values;
+    Coord time;
+    // Set by advance_to_next_event, whose event is usually between whole times: the heap is then in its
+    // order just after this time, and inserts, erases and updates keep to that order and certificate
+    // it as of this time until fastforward moves past it.
+    std::optional<Failure> event_time;
+
+    // Whether fastforward can go back in time by processing rewinds. The first negative fastforward
+    // sets it and rebuilds; set it and call rebuild() up front to avoid that.
+    bool reversible = false;
+
+    // fastforward re-heapifies at the target time instead of processing events one at a time
+    // once more than rebuild_factor * size() certificates fail within a single call.
+    double rebuild_factor = 1.0;
+    // Number of certificate failures processed and number of re-heapifies, over the heap's lifetime.
+    size_t events_processed = 0;
+    size_t rebuilds = 0;
+
+    // Approximate mode, when epsilon > 0: the order is only guaranteed to be right as of epsilon ago.
+    // Certificates failing within epsilon of the target time are left for later, and the ones failing
+    // within epsilon of each other are processed as one batch whose certificates are recomputed once.
+    // Going back to exact mode takes a rebuild().
+    double epsilon = 0;
+    // Number of batches, and of swaps made without going through the event queue because a batch
+    // handles the cascade of a failure on the spot, over the heap's lifetime.
+    size_t batches = 0;
+    size_t events_saved = 0;
+
+    // The item at index i of items_ gets handle i + 1.
+    KineticHeap(std::vector<MovingObject<T, Coord> > items_)
+        : nodes(1), event_links{&nodes, 0}, rewind_links{&nodes, rewind_tag}, events(&event_links), rewinds(&rewind_links), node_of(items_.size() + 1), values(items_.size() + 1), time(0) {
+        std::vector<Item> initial;
+        initial.reserve(items_.size());
+        for (size_t i = 0; i < items_.size(); ++i) {
+            initial.push_back(items_[i].trajectory(i + 1));
+            values[i + 1] = items_[i].value;
+        }
+        build(initial);
     }
 
-    static constexpr size_t sibling(size_t i) {
-        return i ^ 1;
+    static constexpr size_t root() {
+        return 1;
     }
 
     static constexpr size_t parent(size_t i) {
         return i / 2;
     }
 
+    static constexpr size_t sibling(size_t i) {
+        return i ^ 1;
+    }
+
     static constexpr size_t left(size_t i) {
         return 2 * i;
     }
@@ -42,186 +120,499 @@ struct MinHeap {
         return 2 * i + 1;
     }
 
-    // Gets the minimum element if it exists
-    std::optional<T> min() const {
-        return vec.size() > root() ? std::make_optional(vec[root()].t) : std::nullopt;
+    size_t size() const {
+        return nodes.size() - root();
     }
 
-    std::optional<size_t> min_ref_index() const {
-        return vec.size() > root() ? std::make_optional(vec[root()].ref_index) : std::nullopt;
+    // Number of certificate failures within one fastforward above which a rebuild is cheaper
+    size_t rebuild_threshold() const {
+        // Capped so that callers can add one without overflowing, even for an infinite factor
+        double threshold = rebuild_factor * size();
+        size_t cap = std::numeric_limits<size_t>::max() - 1;
+        return threshold < cap ? static_cast<size_t>(threshold) : cap;
     }
 
-    // Swaps two elements and updates ref indexes
-    void swap(size_t i, size_t j) {
-        std::swap(vec[i], vec[j]);
-        if constexpr (!Standalone) {
-            ref->set_ref_index(vec[i].ref_index, i);
-            ref->set_ref_index(vec[j].ref_index, j);
-        }
+    // Whether the item at node i belongs above the item at node j at the current time, or just after event_time
+    bool less(size_t i, size_t j) const {
+        return less(nodes[i].item, nodes[j].item);
+    }
+
+    bool less(const Item& a, const Item& b) const {
+        if (event_time)
+            return ExactPositionAt<Coord> { *event_time }(a, b);
+        return BasicPositionAt<Coord> { time }(a, b);
     }
 
-    // Gets the ref_index of element i, assuming i != 0
-    size_t ref_index(size_t i) const {
-        return vec[i].ref_index;
+    // Time the order of the heap is for, which certificates recomputed now start from
+    Failure now() const {
+        return event_time ? *event_time : Traits::whole(time);
     }
 
-    void set_ref_index(size_t i, size_t ref_index) {
-        if (i != 0)
-            vec[i].ref_index = ref_index;
+    // Swaps the items of two nodes. Their certificates stay where they are.
+    void swap_items(size_t i, size_t j) {
+        std::swap(nodes[i].item, nodes[j].item);
+        node_of[nodes[i].item.id] = i;
+        node_of[nodes[j].item.id] = j;
     }
 
-    // Heap up the element at some index and return its new index
-    size_t heap_up(size_t index) {
-        while (index > root()) {
-            size_t parent_index = parent(index);
-            if (vec[index].t < vec[parent_index].t) {
-                swap(index, parent_index);
-            } else {
+    // Heap up the item at some node and return its new node. Certificates are not maintained.
+    size_t sift_up(size_t i) {
+        while (i > root() && less(i, parent(i))) {
+            swap_items(i, parent(i));
+            i = parent(i);
+        }
+        return i;
+    }
+
+    // Heap down the item at some node and return its new node. Certificates are not maintained.
+    size_t sift_down(size_t i) {
+        while (left(i) < nodes.size()) {
+            size_t smaller = right(i) < nodes.size() && less(right(i), left(i)) ? right(i) : left(i);
+            if (!less(smaller, i))
                 break;
+            swap_items(i, smaller);
+            i = smaller;
+        }
+        return i;
+    }
+
+    // Heapifies trajectories at the current time and computes all certificates from scratch, in O(n).
+    // Each trajectory's id is its handle. Every pass is split across threads for large inputs, see parallel.h.
+    void build(const std::vector<Item>& items_) {
+        event_time.reset();
+        nodes.resize(root() + items_.size());
+        events.clear();
+        rewinds.clear();
+        parallel::for_each_index(0, items_.size(), [&](size_t i) {
+            nodes[root() + i] = Node { items_[i], 0 };
+        });
+
+        // Floyd's bottom-up heapify, moving a hole instead of swapping
+        parallel::heapify(root(), nodes.size() / 2 + 1, left, [this](size_t i) {
+            Item hole = nodes[i].item;
+            size_t index = i;
+            while (left(index) < nodes.size()) {
+                size_t smaller = right(index) < nodes.size() && less(right(index), left(index)) ? right(index) : left(index);
+                if (!less(nodes[smaller].item, hole))
+                    break;
+                nodes[index].item = nodes[smaller].item;
+                index = smaller;
+            }
+            nodes[index].item = hole;
+        });
+        parallel::for_each_index(root(), nodes.size(), [this](size_t i) {
+            node_of[nodes[i].item.id] = i;
+        });
+
+        // Certificates between every node and its parent, in one pass per thread.
+        // certified is 1 for a certificate in events and 2 for one in rewinds. An exact failure time is
+        // two differences, with no division to vectorize, so this reads the nodes in place: copying them
+        // out to a TrajectoryStore for the kernels in simd costs more than the pass itself.
+        size_t first = left(root());
+        size_t n = nodes.size() > first ? nodes.size() - first : 0;
+        Failure now = Traits::whole(time);
+        std::vector<Failure> failures(n);
+        std::vector<uint8_t> certified(n, 0);
+        parallel::for_chunks(n, parallel::workers(n), [&](size_t, size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                const Item &above = nodes[parent(first + k)].item, &below = nodes[first + k].item;
+                if (above.slope > below.slope) {
+                    failures[k] = Traits::failure(above, below);
+                    certified[k] = failures[k] >= now ? 1 : 0;
+                } else if (reversible && above.slope < below.slope) {
+                    failures[k] = Traits::failure(below, above);
+                    certified[k] = failures[k] <= now ? 2 : 0;
+                }
             }
-            index = parent_index;
+        });
+        parallel::append_if(events.vec, n,
+            [&](size_t k) { return certified[k] == 1; },
+            [&](size_t k) { return typename decltype(events)::Element { failures[k], static_cast<uint32_t>(first + k) }; });
+        parallel::heapify(events);
+        parallel::relink(events);
+        if (reversible) {
+            parallel::append_if(rewinds.vec, n,
+                [&](size_t k) { return certified[k] == 2; },
+                [&](size_t k) { return typename decltype(rewinds)::Element { failures[k], static_cast<uint32_t>(first + k) }; });
+            parallel::heapify(rewinds);
+            parallel::relink(rewinds);
         }
-        return index;
     }
 
-    // Heap down the element at some index and return its new index
-    size_t heap_down(size_t index) {
-        while (left(index) < vec.size()) {
-            // Find smaller child
-            bool has_right = right(index) < vec.size();
-            size_t smaller = has_right && vec[right(index)].t < vec[left(index)].t ? right(index) : left(index);
+    void rebuild() {
+        std::vector<Item> current;
+        current.reserve(size());
+        for (size_t i = root(); i < nodes.size(); ++i)
+            current.push_back(nodes[i].item);
+        build(current);
+        ++rebuilds;
+    }
 
-            if (vec[smaller].t < vec[index].t) {
-                swap(index, smaller);
-            } else {
-                break;
+    // Recomputes the certificate comparing node i and its parent as of time now.
+    // If they're moving away from each other, the certificate is the time they last crossed,
+    // and it's only kept when the heap is reversible.
+    void set_certificate(size_t i, const Failure& now) {
+        const Item &above = nodes[parent(i)].item, &below = nodes[i].item;
+        if (above.slope > below.slope) {
+            Failure failure = Traits::failure(above, below);
+            if (failure >= now) {
+                schedule_certificate(events, 0, i, failure);
+                return;
+            }
+        } else if (reversible && above.slope < below.slope) {
+            Failure failure = Traits::failure(below, above);
+            if (failure <= now) {
+                schedule_certificate(rewinds, rewind_tag, i, failure);
+                return;
             }
-            index = smaller;
         }
-        return index;
+        clear_certificate(i);
     }
 
-    // Adds an element to the heap.
-    // ref_index is 0 if nothing is being referenced.
-    void add(T t, size_t ref_index) {
-        size_t index = vec.size();
-        vec.push_back(Element { t, ref_index });
-        if constexpr (!Standalone)
-            ref->set_ref_index(ref_index, index);
+    // Approximate mode's version of set_certificate. The order can lag behind there, so a certificate
+    // that already failed is kept for processing, and a pair that's out of order at time at and will
+    // never cross is scheduled to swap at that time.
+    void set_lagging_certificate(size_t i, double at) {
+        const Item &above = nodes[parent(i)].item, &below = nodes[i].item;
+        if (above.slope > below.slope)
+            schedule_certificate(events, 0, i, Traits::failure(above, below));
+        else if (below.intercept + static_cast<double>(below.slope) * at < above.intercept + static_cast<double>(above.slope) * at)
+            schedule_certificate(events, 0, i, Traits::at(at));
+        else
+            clear_certificate(i);
+    }
 
-        heap_up(index);
+    // Sets the certificate of node i to fail at the given time, in queue, which is events (tag 0) or rewinds.
+    // An existing certificate in the same queue gets its key updated in place rather than removed and re-added.
+    template<typename Queue>
+    void schedule_certificate(Queue& queue, uint32_t tag, size_t i, const Failure& failure) {
+        uint32_t event = nodes[i].event;
+        if (event != 0 && (event & rewind_tag) == tag) {
+            queue.update(event & ~rewind_tag, failure);
+        } else {
+            clear_certificate(i);
+            queue.add(failure, i);
+        }
     }
 
-    // Removes the element at a specific index.
-    void remove(size_t i) {
-        if (i != 0) {
-            if constexpr (!Standalone) {
-                ref->set_ref_index(vec[vec.size() - 1].ref_index, i);
-                ref->set_ref_index(vec[i].ref_index, 0); // Untrack this
-            }
-            vec[i] = vec[vec.size() - 1];
-            vec.pop_back();
+    // Removes the certificate comparing node i and its parent, if there is one
+    void clear_certificate(size_t i) {
+        uint32_t event = nodes[i].event;
+        if (event & rewind_tag)
+            rewinds.remove(event & ~rewind_tag);
+        else
+            events.remove(event);
+    }
+
+    // Recomputes the certificates of node i and of its children
+    void refresh_certificates(size_t i) {
+        for (size_t j : {i, left(i), right(i)}) {
+            if (j >= nodes.size() || j == root())
+                continue;
+            if (epsilon > 0)
+                set_lagging_certificate(j, Traits::to_double(now()));
+            else
+                set_certificate(j, now());
+        }
+    }
 
-            // Heap down
-            size_t index = heap_down(i);
-            if (index == i)
-                heap_up(index);
+    // Recomputes the certificates along the path from node lower up to its ancestor upper,
+    // which is every certificate a sift between the two can have changed.
+    void refresh_path(size_t lower, size_t upper) {
+        if (lower < upper)
+            std::swap(lower, upper);
+        for (size_t i = lower; ; i = parent(i)) {
+            refresh_certificates(i);
+            if (i <= upper)
+                break;
         }
     }
 
-    // Gets the minimum element and removes it if it exists
-    std::optional<T> remove_min() {
-        std::optional<T> min_elem = min();
-        if (min_elem.has_value()) {
-            remove(root());
+    // Adds an object in O(log n) and returns a handle to it that stays valid until it's erased.
+    // object.curtime is ignored; the heap's own time is used.
+    size_t insert(const MovingObject<T, Coord>& object) {
+        size_t handle;
+        if (free_handles.empty()) {
+            handle = node_of.size();
+            node_of.push_back(0);
+            values.emplace_back();
+        } else {
+            handle = free_handles.back();
+            free_handles.pop_back();
         }
 
-        return min_elem;
+        values[handle] = object.value;
+        size_t leaf = nodes.size();
+        nodes.push_back(Node { object.trajectory(handle), 0 });
+        node_of[handle] = leaf;
+        refresh_path(leaf, sift_up(leaf));
+        return handle;
     }
-};
 
-template<typename T>
-struct KineticHeap {
-    MinHeap<MovingObject<T>, double> items;
-    // Each node (except the root) has a certificate comparing it to its parent.
-    MinHeap<double, MovingObject<T> > certificates;
-    int time;
+    // Removes the object with the given handle in O(log n).
+    void erase(size_t handle) {
+        size_t index = node_of[handle];
+        size_t last = nodes.size() - 1;
 
-    KineticHeap(std::vector<MovingObject<T> > items_) : items(&certificates), certificates(&items), time(0) {
-        for (MovingObject<T> item_ : items_) {
-            item_.curtime = &time;
-            items.add(item_, 0);
+        clear_certificate(last);
+        if (index != last) {
+            nodes[index].item = nodes[last].item;
+            node_of[nodes[index].item.id] = index;
         }
-
-        for (size_t i = items.left(items.root()); i < items.vec.size(); ++i) {
-            maybeAddCertificate(i, time);
+        nodes.pop_back();
+        node_of[handle] = 0;
+        free_handles.push_back(handle);
+
+        if (index != last) {
+            size_t moved = sift_down(index);
+            if (moved == index)
+                moved = sift_up(index);
+            refresh_path(index, moved);
         }
     }
 
-    // Potentially add a certificate comparing element i and its parent.
-    // No certificate gets added if they're moving away from each other.
-    void maybeAddCertificate(size_t i, double time) {
-        MovingObject<T>& item = items.vec[i].t;
-        MovingObject<T>& parent = items.vec[items.parent(i)].t;
-        double intersection = item.getIntersectionTime(parent);
-        if (intersection > time || intersection == time && item.velocity < parent.velocity)
-            certificates.add(intersection, i);
+    // Changes the trajectory of an object in O(log n), so that it's at position now and moves at velocity from now on.
+    void update_trajectory(size_t handle, Coord position, Coord velocity) {
+        size_t index = node_of[handle];
+        Item& trajectory = nodes[index].item;
+        trajectory.intercept = position - velocity * time;
+        trajectory.slope = velocity;
+
+        size_t moved = sift_down(index);
+        if (moved == index)
+            moved = sift_up(index);
+        refresh_path(index, moved);
     }
 
-    std::optional<MovingObject<T>> min() {
-        return items.min();
+    // Gets the object with the given handle
+    MovingObject<T, Coord> get(size_t handle) {
+        return MovingObject<T, Coord>(nodes[node_of[handle]].item, &time, values[handle]);
     }
 
-    void fastforward(int timeToForward) {
-        time += timeToForward;
+    std::optional<size_t> min_handle() const {
+        return size() > 0 ? std::make_optional<size_t>(nodes[root()].item.id) : std::nullopt;
+    }
+
+    std::optional<MovingObject<T, Coord>> min() {
+        if (size() == 0)
+            return std::nullopt;
+        const Item& item = nodes[root()].item;
+        return MovingObject<T, Coord>(item, &time, values[item.id]);
+    }
 
-        while (certificates.min().value_or(std::numeric_limits<double>::infinity()) < time) {
-            double time = certificates.min().value();
-            size_t swap_i = certificates.min_ref_index().value();
-            size_t parent = items.parent(swap_i); // must exist since the root node has no certificate
-
-            // Up to 5 certificates need to be invalidated.
-            certificates.remove_min();
-            certificates.remove(items.ref_index(parent));
-            if (items.sibling(swap_i) < items.vec.size()) {
-                certificates.remove(items.ref_index(items.sibling(swap_i)));
-                // Can't exist if sibling doesn't
-                if (items.left(swap_i) < items.vec.size()) {
-                    certificates.remove(items.ref_index(items.left(swap_i)));
-                    // Can't exist if left child doesn't
-                    if (items.right(swap_i) < items.vec.size())
-                        certificates.remove(items.ref_index(items.right(swap_i)));
+    // Number of certificates that have failed but are left for later in approximate mode
+    size_t deferred_events() const {
+        return events.count_less(Traits::whole(time), std::numeric_limits<size_t>::max());
+    }
+
+    // Whether some certificate fails before the given time
+    bool fails_before(const Failure& bound) const {
+        return !events.empty() && events.vec[events.root()].t < bound;
+    }
+
+    // Whether some certificate fails after the given time, going back in time
+    bool fails_after(const Failure& bound) const {
+        return !rewinds.empty() && rewinds.vec[rewinds.root()].t > bound;
+    }
+
+    // Processes the certificates failing before horizon in batches spanning epsilon each.
+    // Every failure in a batch is handled as of the end of its window: the item swaps with its parent,
+    // and the swaps that cascade from it are made right away as long as some pair is out of order
+    // at that time, instead of each becoming an event of its own.
+    void process_batches(double horizon, size_t threshold) {
+        size_t processed = 0;
+        std::vector<size_t> pending;
+        while (fails_before(Traits::at(horizon))) {
+            double end = std::min(Traits::to_double(*events.min()) + epsilon, horizon);
+            BasicPositionAt<double> order { end };
+            ++batches;
+
+            while (fails_before(Traits::at(end))) {
+                if (processed > threshold) {
+                    rebuild();
+                    return;
+                }
+                ++events_processed;
+
+                size_t node = events.min_ref_index().value();
+                events.remove_min();
+                size_t swaps = 0;
+                // Nodes that might be out of order with their parent. A swap can only break the order between
+                // the item moving up and its new parent, or between the item moving down and its new children.
+                pending.push_back(node);
+                while (!pending.empty()) {
+                    size_t i = pending.back();
+                    pending.pop_back();
+                    if (i == root() || !order(nodes[i].item, nodes[parent(i)].item))
+                        continue;
+                    swap_items(i, parent(i));
+                    ++swaps;
+                    // Same certificates as an event changes, plus the swapped pair's own in case
+                    // it was only scheduled because set_lagging_certificate found it out of order.
+                    for (size_t j : { i, parent(i), sibling(i), left(i), right(i) }) {
+                        if (j < nodes.size() && j != root())
+                            set_lagging_certificate(j, end);
+                    }
+                    pending.push_back(parent(i));
+                    for (size_t child : { left(i), right(i) })
+                        if (child < nodes.size())
+                            pending.push_back(child);
+                }
+                // The certificate failed early but its pair is still in order, so it needs a new one.
+                // Its failure can be after end and still before end rounded up to a failure time, and
+                // then it moves to the rounded end, or this batch would keep taking it up again.
+                if (swaps == 0) {
+                    set_lagging_certificate(node, end);
+                    uint32_t event = nodes[node].event;
+                    if (event != 0 && events.vec[event].t < Traits::at(end))
+                        events.update(event, Traits::at(end));
                 }
+
+                processed += std::max<size_t>(swaps, 1);
+                events_saved += swaps > 1 ? swaps - 1 : 0;
             }
+        }
+    }
 
-            items.swap(swap_i, parent);
-
-            // Up to 4 certificates need to be added.
-            // The new node at index swap_i does not get a certificate since it just overtook its now-parent.
-            if (parent != items.root())
-                maybeAddCertificate(parent, time);
-            if (items.sibling(swap_i) < items.vec.size()) {
-                maybeAddCertificate(items.sibling(swap_i), time);
-                // Can't exist if sibling doesn't
-                if (items.left(swap_i) < items.vec.size()) {
-                    maybeAddCertificate(items.left(swap_i), time);
-                    // Can't exist if left child doesn't
-                    if (items.right(swap_i) < items.vec.size())
-                        maybeAddCertificate(items.right(swap_i), time);
-                }
+    // Moves the heap timeToForward ahead, or back if it's negative. Going back costs the same per event
+    // as going forward, once the heap is reversible.
+    void fastforward(Coord timeToForward) {
+        time += timeToForward;
+        if (event_time && (timeToForward < 0 || *event_time < Traits::whole(time)))
+            event_time.reset();
+        if (timeToForward < 0) {
+            rewind();
+            return;
+        }
+
+        // Rebuild straight away if the certificates that already fail outnumber the threshold,
+        // and otherwise give up on events as soon as the cascade they cause exceeds it.
+        // In approximate mode the certificates failing after horizon are left for later.
+        size_t threshold = rebuild_threshold();
+        Failure horizon = epsilon > 0 ? Traits::at(time - epsilon) : Traits::whole(time);
+        if (events.count_less(horizon, threshold + 1) > threshold) {
+            rebuild();
+            return;
+        }
+        if (epsilon > 0) {
+            process_batches(time - epsilon, threshold);
+            return;
+        }
+
+        size_t processed = 0;
+        while (fails_before(horizon)) {
+            if (processed++ == threshold) {
+                rebuild();
+                break;
+            }
+            process_event();
+        }
+    }
+
+    // Undoes the events that happened after the current time, latest first, with the same threshold as fastforward.
+    // Approximate mode only ever goes back by rebuilding.
+    void rewind() {
+        size_t threshold = rebuild_threshold();
+        Failure horizon = Traits::whole(time);
+        if (!reversible || epsilon > 0 || rewinds.count_less(horizon, threshold + 1) > threshold) {
+            reversible = true;
+            rebuild();
+            return;
+        }
+
+        size_t processed = 0;
+        while (fails_after(horizon)) {
+            if (processed++ == threshold) {
+                rebuild();
+                break;
+            }
+            process_rewind();
+        }
+    }
+
+    // Time after which the next certificate fails, which is when the heap next changes, or nullopt if it never does.
+    // In approximate mode that's epsilon after the failure, when fastforward would get to it.
+    std::optional<double> next_event_time() const {
+        if (events.empty())
+            return std::nullopt;
+        return Traits::to_double(*events.min()) + epsilon;
+    }
+
+    // Processes everything that happens at next_event_time(), leaving the heap in its order just after
+    // that time, and returns the time. Simultaneous failures are all processed, and in approximate mode
+    // that's the batch starting epsilon earlier. time moves to the event with floating-point coordinates,
+    // and otherwise to the last whole time not after it, and fastforward carries on from there.
+    // Until then the heap keeps to the order after the event, see event_time.
+    std::optional<double> advance_to_next_event() {
+        if (events.empty())
+            return std::nullopt;
+        Failure next = *events.min();
+        if (epsilon > 0) {
+            double end = Traits::to_double(next) + epsilon;
+            process_batches(end, std::numeric_limits<size_t>::max());
+            next = Traits::at(end);
+        } else {
+            while (events.min() == next)
+                process_event();
+        }
+        if (next < Traits::whole(time))
+            event_time.reset();
+        else
+            event_time = next;
+        time = std::max(time, Traits::clock(next));
+        return Traits::to_double(next);
+    }
+
+    // Processes the certificate that fails first: the item of its node overtakes the item of the parent.
+    void process_event() {
+        Failure now = events.min().value();
+        size_t swap_i = events.min_ref_index().value();
+        events.remove_min();
+        swap_with_parent(swap_i, now);
+    }
+
+    // Processes the certificate that failed last, going back in time: the item of its node was overtaken
+    // by the item of the parent at that time, so they swap back.
+    void process_rewind() {
+        Failure now = rewinds.min().value();
+        size_t swap_i = rewinds.min_ref_index().value();
+        rewinds.remove_min();
+        swap_with_parent(swap_i, now);
+    }
+
+    // Swaps the item of node swap_i with its parent's at time now, once the certificate between them is removed
+    void swap_with_parent(size_t swap_i, const Failure& now) {
+        ++events_processed;
+        size_t parent = this->parent(swap_i); // must exist since the root node has no certificate
+        swap_items(swap_i, parent);
+
+        // The pair that just crossed only gets the certificate of its crossing back if the heap is reversible,
+        // since they're moving apart. Up to 4 other certificates change, and get updated in place.
+        if (reversible)
+            set_certificate(swap_i, now);
+        if (parent != root())
+            set_certificate(parent, now);
+        if (sibling(swap_i) < nodes.size()) {
+            set_certificate(sibling(swap_i), now);
+            // Can't exist if sibling doesn't
+            if (left(swap_i) < nodes.size()) {
+                set_certificate(left(swap_i), now);
+                // Can't exist if left child doesn't
+                if (right(swap_i) < nodes.size())
+                    set_certificate(right(swap_i), now);
             }
         }
     }
 };
 
-template<typename T>
-std::ostream& operator<<(std::ostream& out, const KineticHeap<T>& heap) {
+template<typename T, size_t CertificateArity, typename Coord>
+std::ostream& operator<<(std::ostream& out, const KineticHeap<T, CertificateArity, Coord>& heap) {
     out << "Item: ";
-    for (int i = heap.items.root(); i < heap.items.vec.size(); ++i)
-        out << "(" << heap.items.vec[i].t.value << ", " << heap.items.ref_index(i) << "), ";
+    for (size_t i = heap.root(); i < heap.nodes.size(); ++i)
+        out << "(" << heap.values[heap.nodes[i].item.id] << ", " << heap.nodes[i].item.id << "), ";
     out << "\nCert: ";
-    for (int i = heap.certificates.root(); i < heap.certificates.vec.size(); ++i)
-        out << "(" << heap.certificates.vec[i].t << ", " << heap.certificates.ref_index(i) << "), ";
+    for (size_t i = heap.events.root(); i < heap.events.vec.size(); ++i)
+        out << "(" << KineticHeap<T, CertificateArity, Coord>::Traits::to_double(heap.events.vec[i].t) << ", " << heap.events.ref_index(i) << "), ";
     out << "\n";
     return out;
 }
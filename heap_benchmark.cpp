@@ -1,12 +1,14 @@
 // The purpose of this file is to test our kinetic heap against the naive heap with Brute-force implementation.
 
 #include "heap.h"
+#include "trajectory_store.h"
 #include <map>
 #include <string>
 #include <stdexcept>
 #include <optional>
 #include <iostream>
 #include <time.h>
+#include <array>
 #include <experimental/random>
 #define assert1(cond) if (!(cond)) {throw std::logic_error("Assertion failed: " #cond);}
 #define assert2(cond, str) if (!(cond)) {throw std::logic_error(str);}
@@ -33,6 +35,12 @@ int main(int argc, char** argv) {
         moving_objs.push_back(moving_obj);
     }
     KineticHeap<int> kinetic_heap(moving_objs);
+    // The initial intercepts and velocities, which the SIMD kernels evaluate at the current time
+    TrajectoryStore store;
+    for (int k = 0; k < num_particle; k++)
+        store.push_back(Trajectory { positions[k], velocities[k], static_cast<uint32_t>(k) });
+    std::vector<int> scanned(num_particle);
+    int now = 0;
 
 
     // Obtain the min values and running times for each time increment
@@ -55,6 +63,18 @@ int main(int argc, char** argv) {
         clock_t heap_end= clock();
         std::cout << j << " [Naive heap]" << "min: "<< heap_min.value() << " time: "<< (heap_end - heap_start) * 1.0 / CLOCKS_PER_SEC*1000 << "ms" << std::endl;
         heap_time_sum += (heap_end - heap_start) * 1.0 / CLOCKS_PER_SEC*1000;
+        // Recompute the min with a vectorized scan over the trajectories at the current time
+        now += time_inc;
+        clock_t scan_start = clock();
+        int scan_min = store.min_position_at(now);
+        clock_t scan_end = clock();
+        std::cout << j << " [SIMD scan]" << "min: "<< scan_min << " time: "<< (scan_end - scan_start) * 1.0 / CLOCKS_PER_SEC*1000 << "ms" << std::endl;
+        // Compute every position at the current time, and the min from them
+        clock_t positions_start = clock();
+        store.positions_at(now, scanned.data());
+        int positions_min = *std::min_element(scanned.begin(), scanned.end());
+        clock_t positions_end = clock();
+        std::cout << j << " [SIMD positions]" << "min: "<< positions_min << " time: "<< (positions_end - positions_start) * 1.0 / CLOCKS_PER_SEC*1000 << "ms" << std::endl;
         // Update the kinetic heap and the heap min with a running time
         clock_t kinetic_heap_start = clock();
         kinetic_heap.fastforward(time_inc);
@@ -65,6 +85,8 @@ int main(int argc, char** argv) {
     }
     std::cout << "Naive heap total time:" << heap_time_sum << "ms" << std::endl;
     std::cout << "Kinetic heap total time:" << kinetic_heap_time_sum << "ms" << std::endl;
+    std::cout << "Kinetic heap events processed: " << kinetic_heap.events_processed << ", rebuilds: " << kinetic_heap.rebuilds
+              << " (threshold " << kinetic_heap.rebuild_threshold() << " events per fastforward)" << std::endl;
 
     std::cout << "Initial positions: " << endl;
     for (int i = 0; i < positions.size(); i++){
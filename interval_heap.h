@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <utility>
+#include "min_heap.h"
+#include "trajectory.h"
+#include "parallel.h"
+
+// A kinetic interval heap, for the min and the max of the same objects at once. Node i holds two items,
+// lo and hi with lo before hi. The los form a min heap and the his a max heap, and the last node can
+// hold a single item that belongs to both. Every certificate says that one item stays at or before
+// another, so one event queue serves all three kinds: inside a node, and between a node and its parent
+// on the min side and on the max side. That's 1.5 certificates per object, against 2 for a min heap
+// and a max heap side by side, and an event is a swap of two items wherever it is.
+// CertificateArity is the arity of the event queue, and Coord the coordinate type, like in KineticHeap.
+template<typename T, size_t CertificateArity = 4, typename Coord = int>
+struct KineticIntervalHeap {
+    using Traits = CoordinateTraits<Coord>;
+    using Failure = typename Traits::Failure;
+    using Item = BasicTrajectory<Coord>;
+
+    // Certificate slot 3 * i + kind belongs to node i
+    static constexpr size_t inside = 0, min_side = 1, max_side = 2;
+
+    // The items of node i are at lo(i) and hi(i). Each item's id is its handle.
+    std::vector<Item> items;
+    // Index in items of each handle. Handles start at 1, so 0 can mean "none".
+    std::vector<size_t> position_of;
+    // Payload of each handle
+    std::vector<T> values;
+    MinHeap<Failure, size_t, false, RefTable, std::less<Failure>, CertificateArity> events;
+    RefTable event_slots;
+    Coord time;
+
+    // Number of certificate failures processed over the heap's lifetime
+    size_t events_processed = 0;
+
+    // The item at index i of items_ gets handle i + 1.
+    KineticIntervalHeap(const std::vector<MovingObject<T, Coord> >& items_)
+        : items(items_.size()), position_of(items_.size() + 1), values(items_.size() + 1), events(&event_slots), time(0) {
+        for (size_t i = 0; i < items_.size(); ++i) {
+            items[i] = items_[i].trajectory(i + 1);
+            values[i + 1] = items_[i].value;
+        }
+        build();
+    }
+
+    static constexpr size_t lo(size_t i) {
+        return 2 * (i - 1);
+    }
+
+    static constexpr size_t hi(size_t i) {
+        return 2 * (i - 1) + 1;
+    }
+
+    // Node holding the item at index p of items
+    static constexpr size_t node_of(size_t p) {
+        return p / 2 + 1;
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    size_t nodes() const {
+        return (items.size() + 1) / 2;
+    }
+
+    // Index of the item of node i on the max side, which is its lo if that's its only item
+    size_t upper(size_t i) const {
+        return hi(i) < items.size() ? hi(i) : lo(i);
+    }
+
+    // Sorts at the current time and lays the order out in O(n): node i gets the i-th lowest item as lo
+    // and the i-th highest as hi, which satisfies every certificate. Then computes all certificates from scratch.
+    void build() {
+        std::vector<Item> order = items;
+        parallel::sort(order, BasicPositionAt<Coord> { time });
+        size_t n = items.size();
+        for (size_t i = 1; i <= nodes(); ++i) {
+            items[lo(i)] = order[i - 1];
+            if (hi(i) < n)
+                items[hi(i)] = order[n - i];
+        }
+        for (size_t p = 0; p < n; ++p)
+            position_of[items[p].id] = p;
+
+        events.clear();
+        event_slots.index.assign(3 * (nodes() + 1), 0);
+        Failure now = Traits::whole(time);
+        for (size_t slot = 3; slot < event_slots.index.size(); ++slot) {
+            size_t above, below;
+            if (pair_of(slot, above, below) && items[above].slope > items[below].slope) {
+                Failure failure = Traits::failure(items[above], items[below]);
+                if (failure >= now)
+                    events.vec.push_back({ failure, slot });
+            }
+        }
+        events.heapify();
+        events.relink();
+    }
+
+    // Indexes in items of the two items that certificate slot compares, the one that must stay at or
+    // before the other first. Returns false if node slot / 3 has no such pair.
+    bool pair_of(size_t slot, size_t& above, size_t& below) const {
+        size_t i = slot / 3;
+        switch (slot % 3) {
+        case inside:
+            above = lo(i);
+            below = hi(i);
+            return below < items.size();
+        case min_side:
+            above = lo(i / 2);
+            below = lo(i);
+            return i > 1;
+        default:
+            above = upper(i);
+            below = hi(i / 2);
+            return i > 1;
+        }
+    }
+
+    // Recomputes the certificate of slot as of time now, updating it in place if it exists.
+    // No certificate is kept if the pair is moving apart.
+    void set_certificate(size_t slot, const Failure& now) {
+        size_t above, below;
+        size_t index = event_slots.index[slot];
+        if (pair_of(slot, above, below) && items[above].slope > items[below].slope) {
+            Failure failure = Traits::failure(items[above], items[below]);
+            if (failure >= now) {
+                if (index != 0)
+                    events.update(index, failure);
+                else
+                    events.add(failure, slot);
+                return;
+            }
+        }
+        events.remove(index);
+    }
+
+    // Recomputes every certificate that compares the item at index p of items
+    void refresh_certificates(size_t p, const Failure& now) {
+        size_t i = node_of(p);
+        set_certificate(3 * i + inside, now);
+        for (size_t side : { min_side, max_side }) {
+            if (p != (side == min_side ? lo(i) : upper(i)))
+                continue;
+            set_certificate(3 * i + side, now);
+            for (size_t child : { 2 * i, 2 * i + 1 })
+                if (lo(child) < items.size())
+                    set_certificate(3 * child + side, now);
+        }
+    }
+
+    // Gets the object with the given handle
+    MovingObject<T, Coord> get(size_t handle) {
+        return MovingObject<T, Coord>(items[position_of[handle]], &time, values[handle]);
+    }
+
+    std::optional<size_t> min_handle() const {
+        return !items.empty() ? std::make_optional<size_t>(items[lo(1)].id) : std::nullopt;
+    }
+
+    std::optional<size_t> max_handle() const {
+        return !items.empty() ? std::make_optional<size_t>(items[upper(1)].id) : std::nullopt;
+    }
+
+    std::optional<MovingObject<T, Coord> > min() {
+        if (items.empty())
+            return std::nullopt;
+        return get(items[lo(1)].id);
+    }
+
+    std::optional<MovingObject<T, Coord> > max() {
+        if (items.empty())
+            return std::nullopt;
+        return get(items[upper(1)].id);
+    }
+
+    // Processes the certificate that fails first: its two items swap, and the certificates of both are recomputed.
+    void process_event() {
+        ++events_processed;
+        Failure now = events.min().value();
+        size_t slot = events.min_ref_index().value();
+        events.remove_min();
+
+        size_t above, below;
+        pair_of(slot, above, below);
+        std::swap(items[above], items[below]);
+        position_of[items[above].id] = above;
+        position_of[items[below].id] = below;
+        refresh_certificates(above, now);
+        refresh_certificates(below, now);
+    }
+
+    // Moves the heap timeToForward ahead, which must not be negative
+    void fastforward(Coord timeToForward) {
+        time += timeToForward;
+        Failure horizon = Traits::whole(time);
+        while (!events.empty() && *events.min() < horizon)
+            process_event();
+    }
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <utility>
+#include "min_heap.h"
+#include "trajectory.h"
+
+// Kinetic leftist heaps that can be melded and split, such as one per spatial cell as cells merge and
+// subdivide. All the heaps live in one forest with a single event queue, so melding two of them never
+// has to merge their certificates: it walks down their right spines, which are O(log n) long in a
+// leftist heap, and only the nodes that get a new parent along the way get a new certificate.
+// Like in KineticHeap, certificates belong to nodes and an event swaps the items of a node and its parent.
+// CertificateArity is the arity of the event queue, and Coord the coordinate type, like in KineticHeap.
+template<typename T, size_t CertificateArity = 4, typename Coord = int>
+struct KineticLeftistForest {
+    using Traits = CoordinateTraits<Coord>;
+    using Failure = typename Traits::Failure;
+    using Item = BasicTrajectory<Coord>;
+
+    struct Node {
+        // The id of the item is its handle.
+        Item item;
+        uint32_t parent, left, right;
+        // Length of the shortest path down to a missing child, which is never shorter on the left
+        uint32_t rank;
+    };
+
+    // nodes[0] stands for a missing node, with rank 0
+    std::vector<Node> nodes;
+    std::vector<size_t> free_nodes;
+    // Root node of each heap, or 0 if it's empty, and its number of objects
+    std::vector<size_t> roots;
+    std::vector<size_t> sizes;
+    // Node holding the item for each handle, or 0 once it's popped. Handles start at 1 and aren't reused.
+    std::vector<size_t> node_of;
+    // Payload of each handle
+    std::vector<T> values;
+    // Certificate failure times keyed by node, for the certificate comparing a node's item with its parent's
+    MinHeap<Failure, size_t, false, RefTable, std::less<Failure>, CertificateArity> events;
+    RefTable event_slots;
+    Coord time;
+
+    // Number of certificate failures processed over the forest's lifetime
+    size_t events_processed = 0;
+
+    KineticLeftistForest() : nodes(1, Node {}), node_of(1), values(1), events(&event_slots), event_slots(1), time(0) {}
+
+    // Number of heaps, including the empty ones
+    size_t heaps() const {
+        return roots.size();
+    }
+
+    size_t size(size_t heap) const {
+        return sizes[heap];
+    }
+
+    // Adds a heap of the given objects in O(n) and returns its index. Handles are given out in order,
+    // so the object at index i of items gets handle node_of.size() + i, as of before the call.
+    size_t add_heap(const std::vector<MovingObject<T, Coord> >& items) {
+        std::vector<size_t> singles;
+        singles.reserve(items.size());
+        for (const MovingObject<T, Coord>& object : items)
+            singles.push_back(new_node(object));
+        roots.push_back(meld_all(singles));
+        sizes.push_back(items.size());
+        return roots.size() - 1;
+    }
+
+    // Adds an object to a heap in O(log n) and returns its handle
+    size_t insert(size_t heap, const MovingObject<T, Coord>& object) {
+        size_t node = new_node(object);
+        roots[heap] = meld_nodes(roots[heap], node, Traits::whole(time));
+        ++sizes[heap];
+        return nodes[node].item.id;
+    }
+
+    // Moves every object of heap from into heap into, in O(log n), leaving from empty
+    void meld(size_t into, size_t from) {
+        if (into == from)
+            return;
+        roots[into] = meld_nodes(roots[into], roots[from], Traits::whole(time));
+        sizes[into] += sizes[from];
+        roots[from] = 0;
+        sizes[from] = 0;
+    }
+
+    // Moves the objects of heap for which keep returns false into a new heap, and returns its index.
+    // keep gets each object as of the current time. Both heaps are rebuilt, in O(n) melds.
+    template<typename Predicate>
+    size_t split(size_t heap, Predicate keep) {
+        std::vector<size_t> kept, moved, stack;
+        if (roots[heap] != 0)
+            stack.push_back(roots[heap]);
+        while (!stack.empty()) {
+            size_t i = stack.back();
+            stack.pop_back();
+            for (size_t child : { nodes[i].left, nodes[i].right })
+                if (child != 0)
+                    stack.push_back(child);
+            detach(i);
+            nodes[i].left = nodes[i].right = 0;
+            nodes[i].rank = 1;
+            (keep(get(nodes[i].item.id)) ? kept : moved).push_back(i);
+        }
+        sizes[heap] = kept.size();
+        sizes.push_back(moved.size());
+        roots[heap] = meld_all(kept);
+        roots.push_back(meld_all(moved));
+        return roots.size() - 1;
+    }
+
+    // Removes the lowest object of a non-empty heap in O(log n)
+    void pop_min(size_t heap) {
+        size_t root = roots[heap];
+        size_t left = nodes[root].left, right = nodes[root].right;
+        for (size_t child : { left, right })
+            if (child != 0)
+                detach(child);
+        node_of[nodes[root].item.id] = 0;
+        free_nodes.push_back(root);
+        roots[heap] = meld_nodes(left, right, Traits::whole(time));
+        --sizes[heap];
+    }
+
+    // Gets the object with the given handle
+    MovingObject<T, Coord> get(size_t handle) {
+        return MovingObject<T, Coord>(nodes[node_of[handle]].item, &time, values[handle]);
+    }
+
+    std::optional<size_t> min_handle(size_t heap) const {
+        return roots[heap] != 0 ? std::make_optional<size_t>(nodes[roots[heap]].item.id) : std::nullopt;
+    }
+
+    std::optional<MovingObject<T, Coord> > min(size_t heap) {
+        if (roots[heap] == 0)
+            return std::nullopt;
+        return get(nodes[roots[heap]].item.id);
+    }
+
+    // Takes a node for a new object, with no parent or children
+    size_t new_node(const MovingObject<T, Coord>& object) {
+        size_t handle = node_of.size();
+        node_of.push_back(0);
+        values.push_back(object.value);
+
+        size_t node;
+        if (free_nodes.empty()) {
+            node = nodes.size();
+            nodes.emplace_back();
+            event_slots.index.push_back(0);
+        } else {
+            node = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        nodes[node] = Node { object.trajectory(handle), 0, 0, 0, 1 };
+        node_of[handle] = node;
+        return node;
+    }
+
+    // Cuts node i off from its parent, which is left pointing to it
+    void detach(size_t i) {
+        nodes[i].parent = 0;
+        events.remove(event_slots.index[i]);
+    }
+
+    // Melds the heaps rooted at nodes a and b at the current time and returns the root, which has no certificate.
+    // The merged right spine is the only place where nodes get a new parent, and their certificates are recomputed as of now.
+    size_t meld_nodes(size_t a, size_t b, const Failure& now) {
+        if (a == 0)
+            return b;
+        if (b == 0)
+            return a;
+        if (BasicPositionAt<Coord> { time }(nodes[b].item, nodes[a].item))
+            std::swap(a, b);
+
+        size_t merged = meld_nodes(nodes[a].right, b, now);
+        nodes[a].right = merged;
+        nodes[merged].parent = a;
+        set_certificate(merged, now);
+        if (nodes[nodes[a].left].rank < nodes[merged].rank)
+            std::swap(nodes[a].left, nodes[a].right);
+        nodes[a].rank = nodes[nodes[a].right].rank + 1;
+        return a;
+    }
+
+    // Melds the heaps rooted at the given nodes pairwise, round after round, in O(n) overall.
+    // Each meld's result goes at the back of queue.
+    size_t meld_all(std::vector<size_t>& queue) {
+        Failure now = Traits::whole(time);
+        for (size_t head = 0; head + 1 < queue.size(); head += 2)
+            queue.push_back(meld_nodes(queue[head], queue[head + 1], now));
+        return queue.empty() ? 0 : queue.back();
+    }
+
+    // Recomputes the certificate comparing node i and its parent as of time now, updating it in place if it exists.
+    // No certificate is kept for a root, or if they're moving away from each other.
+    void set_certificate(size_t i, const Failure& now) {
+        size_t index = event_slots.index[i];
+        size_t parent = nodes[i].parent;
+        if (parent != 0) {
+            const Item &above = nodes[parent].item, &below = nodes[i].item;
+            if (above.slope > below.slope) {
+                Failure failure = Traits::failure(above, below);
+                if (failure >= now) {
+                    if (index != 0)
+                        events.update(index, failure);
+                    else
+                        events.add(failure, i);
+                    return;
+                }
+            }
+        }
+        events.remove(index);
+    }
+
+    // Processes the certificate that fails first: the item of its node overtakes the item of the parent.
+    void process_event() {
+        ++events_processed;
+        Failure now = events.min().value();
+        size_t i = events.min_ref_index().value();
+        size_t parent = nodes[i].parent;
+        events.remove_min();
+
+        std::swap(nodes[i].item, nodes[parent].item);
+        node_of[nodes[i].item.id] = i;
+        node_of[nodes[parent].item.id] = parent;
+
+        // The pair that just crossed is moving apart, and up to 4 other certificates change
+        size_t sibling = nodes[parent].left == i ? nodes[parent].right : nodes[parent].left;
+        for (size_t j : { parent, sibling, static_cast<size_t>(nodes[i].left), static_cast<size_t>(nodes[i].right) })
+            if (j != 0)
+                set_certificate(j, now);
+    }
+
+    // Moves every heap timeToForward ahead, which must not be negative
+    void fastforward(Coord timeToForward) {
+        time += timeToForward;
+        Failure horizon = Traits::whole(time);
+        while (!events.empty() && *events.min() < horizon)
+            process_event();
+    }
+};
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <optional>
+#include <type_traits>
+#include <functional>
+#include <algorithm>
+#include <new>
+
+// Allocator that puts the start of every allocation on a cache line boundary
+template<typename T, size_t Alignment = 64>
+struct CacheAlignedAllocator {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = CacheAlignedAllocator<U, Alignment>;
+    };
+
+    CacheAlignedAllocator() = default;
+
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    bool operator==(const CacheAlignedAllocator<U, Alignment>&) const {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const CacheAlignedAllocator<U, Alignment>&) const {
+        return false;
+    }
+};
+
+// A d-ary min heap (Arity is 2, 4 or 8).
+// The root sits at index Arity - 1 and the padding before it is never used, so every group of
+// siblings starts at a multiple of Arity. With the cache line aligned storage, the children that
+// heap_down compares share one cache line (two for Arity 8 with 16-byte elements).
+// Index is the type of ref indexes, which can be narrowed to keep elements small.
+template<typename T, typename Ref, bool Standalone = false, typename Target = void, typename Less = std::less<T>, size_t Arity = 2,
+         typename Index = size_t>
+struct MinHeap {
+    static_assert(Arity == 2 || Arity == 4 || Arity == 8, "MinHeap arity must be 2, 4 or 8");
+
+    struct Element {
+        T t;
+        // Index to the element to reference in the ref.
+        // If this is 0, then no element gets referenced.
+        // Also, not using pointers because vector pointers get invalidated on reallocation
+        Index ref_index;
+    };
+
+    // By default the referenced structure is another heap that references this one back.
+    using RefTarget = std::conditional_t<std::is_void_v<Target>, MinHeap<Ref, T, Standalone>, Target>;
+
+    std::vector<Element, CacheAlignedAllocator<Element> > vec;
+    // The structure to reference.
+    RefTarget* ref;
+    // Ordering of the elements. Stateful comparators (e.g. ones holding a time) can be updated in place.
+    Less less;
+
+    // Add elements before the root to simplify parent-child math
+    MinHeap(RefTarget* ref_, Less less_ = Less()) : vec(root()), ref(ref_), less(less_) {}
+
+    static constexpr size_t root() {
+        return Arity - 1;
+    }
+
+    static constexpr size_t parent(size_t i) {
+        return i / Arity + Arity - 2;
+    }
+
+    static constexpr size_t first_child(size_t i) {
+        return Arity * (i - Arity + 2);
+    }
+
+    // Gets the index of the smallest child of i, assuming i has at least one child.
+    // The selects compile to conditional moves, and full sibling groups have a fixed trip count.
+    size_t min_child(size_t i) const {
+        size_t first = first_child(i);
+        size_t smaller = first;
+        if (first + Arity <= vec.size()) {
+            for (size_t k = 1; k < Arity; ++k)
+                smaller = less(vec[first + k].t, vec[smaller].t) ? first + k : smaller;
+        } else {
+            for (size_t c = first + 1; c < vec.size(); ++c)
+                smaller = less(vec[c].t, vec[smaller].t) ? c : smaller;
+        }
+        return smaller;
+    }
+
+    size_t size() const {
+        return vec.size() - root();
+    }
+
+    bool empty() const {
+        return vec.size() <= root();
+    }
+
+    // Gets the minimum element if it exists
+    std::optional<T> min() const {
+        return vec.size() > root() ? std::make_optional(vec[root()].t) : std::nullopt;
+    }
+
+    std::optional<size_t> min_ref_index() const {
+        return vec.size() > root() ? std::make_optional(vec[root()].ref_index) : std::nullopt;
+    }
+
+    // Swaps two elements and updates ref indexes
+    void swap(size_t i, size_t j) {
+        std::swap(vec[i], vec[j]);
+        if constexpr (!Standalone) {
+            ref->set_ref_index(vec[i].ref_index, i);
+            ref->set_ref_index(vec[j].ref_index, j);
+        }
+    }
+
+    // Gets the ref_index of element i, assuming i != 0
+    size_t ref_index(size_t i) const {
+        return vec[i].ref_index;
+    }
+
+    void set_ref_index(size_t i, size_t ref_index) {
+        if (i != 0)
+            vec[i].ref_index = ref_index;
+    }
+
+    // Heap up the element at some index and return its new index
+    size_t heap_up(size_t index) {
+        while (index > root()) {
+            size_t parent_index = parent(index);
+            if (less(vec[index].t, vec[parent_index].t)) {
+                swap(index, parent_index);
+            } else {
+                break;
+            }
+            index = parent_index;
+        }
+        return index;
+    }
+
+    // Heap down the element at some index and return its new index
+    size_t heap_down(size_t index) {
+        while (first_child(index) < vec.size()) {
+            size_t smaller = min_child(index);
+
+            if (less(vec[smaller].t, vec[index].t)) {
+                swap(index, smaller);
+            } else {
+                break;
+            }
+            index = smaller;
+        }
+        return index;
+    }
+
+    // Moves the element at i down to its place, assuming the subtrees below it are heaps.
+    // Only the subtree of i is touched, and the ref is not told.
+    void settle(size_t i) {
+        Element hole = vec[i];
+        size_t index = i;
+        while (first_child(index) < vec.size()) {
+            size_t smaller = min_child(index);
+            if (!less(vec[smaller].t, hole.t))
+                break;
+            vec[index] = vec[smaller];
+            index = smaller;
+        }
+        vec[index] = hole;
+    }
+
+    // Turns vec into a heap bottom-up in O(n). Elements are moved without telling the ref,
+    // so call relink() afterwards if the ref tracks them.
+    void heapify() {
+        if (vec.size() <= root() + 1)
+            return;
+        for (size_t i = parent(vec.size() - 1); i >= root(); --i)
+            settle(i);
+    }
+
+    // Tells the ref where every element is, in one pass
+    void relink() {
+        if constexpr (!Standalone) {
+            for (size_t i = root(); i < vec.size(); ++i)
+                ref->set_ref_index(vec[i].ref_index, i);
+        }
+    }
+
+    // Adds an element to the heap.
+    // ref_index is 0 if nothing is being referenced.
+    void add(T t, size_t ref_index) {
+        size_t index = vec.size();
+        vec.push_back(Element { t, static_cast<Index>(ref_index) });
+        if constexpr (!Standalone)
+            ref->set_ref_index(ref_index, index);
+
+        heap_up(index);
+    }
+
+    // Changes the element at a specific index and restores the heap order.
+    // This is one sift instead of a remove and an add.
+    size_t update(size_t i, T t) {
+        vec[i].t = t;
+        size_t index = heap_down(i);
+        if (index == i)
+            index = heap_up(index);
+        return index;
+    }
+
+    // Removes the element at a specific index.
+    void remove(size_t i) {
+        if (i != 0) {
+            if constexpr (!Standalone) {
+                ref->set_ref_index(vec[vec.size() - 1].ref_index, i);
+                ref->set_ref_index(vec[i].ref_index, 0); // Untrack this
+            }
+            vec[i] = vec[vec.size() - 1];
+            vec.pop_back();
+            if (i == vec.size())
+                return;
+
+            // Heap down
+            size_t index = heap_down(i);
+            if (index == i)
+                heap_up(index);
+        }
+    }
+
+    // Counts the elements less than bound, stopping early once cap of them have been found.
+    // Only subtrees whose root is less than bound get visited, so this costs O(min(count, cap)).
+    size_t count_less(const T& bound, size_t cap) const {
+        size_t count = 0;
+        std::vector<size_t> stack;
+        if (vec.size() > root())
+            stack.push_back(root());
+        while (!stack.empty() && count < cap) {
+            size_t i = stack.back();
+            stack.pop_back();
+            if (!less(vec[i].t, bound))
+                continue;
+            ++count;
+            size_t first = first_child(i);
+            for (size_t c = first; c < std::min(first + Arity, vec.size()); ++c)
+                stack.push_back(c);
+        }
+        return count;
+    }
+
+    // Appends the ref_index of every element less than bound to out, visiting only those elements' subtrees
+    void ref_indexes_less(const T& bound, std::vector<size_t>& out) const {
+        std::vector<size_t> stack;
+        if (vec.size() > root())
+            stack.push_back(root());
+        while (!stack.empty()) {
+            size_t i = stack.back();
+            stack.pop_back();
+            if (!less(vec[i].t, bound))
+                continue;
+            out.push_back(vec[i].ref_index);
+            size_t first = first_child(i);
+            for (size_t c = first; c < std::min(first + Arity, vec.size()); ++c)
+                stack.push_back(c);
+        }
+    }
+
+    // Removes every element. The ref is not notified.
+    void clear() {
+        vec.resize(root());
+    }
+
+    // Gets the minimum element and removes it if it exists
+    std::optional<T> remove_min() {
+        std::optional<T> min_elem = min();
+        if (min_elem.has_value()) {
+            remove(root());
+        }
+
+        return min_elem;
+    }
+};
+
+// Back-pointers for a MinHeap whose elements reference plain slots instead of another heap.
+// Slot 0 means "no reference", so valid slots start at 1, like heap indexes.
+struct RefTable {
+    // Heap index of each slot's element, or 0 if the slot has no element in the heap.
+    std::vector<size_t> index;
+
+    RefTable(size_t slots = 0) : index(slots, 0) {}
+
+    void set_ref_index(size_t slot, size_t heap_index) {
+        if (slot != 0)
+            index[slot] = heap_index;
+    }
+};
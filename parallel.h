@@ -0,0 +1,357 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Fork-join helpers for the bulk passes of the kinetic structures: building, rebuilding and re-sorting.
+// Work is split into one contiguous chunk per thread, so inputs too small to pay for threads stay on
+// the calling thread and give exactly the same results.
+namespace parallel {
+    // Maximum number of threads to use. Defaults to the number of hardware threads, and can be lowered.
+    inline size_t& max_threads() {
+        static size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        return threads;
+    }
+
+    // Minimum number of elements per thread, below which spawning threads costs more than it saves.
+    // Can be changed, such as lowered to run small inputs on several threads.
+    inline size_t& grain() {
+        static size_t elements = 1 << 14;
+        return elements;
+    }
+
+    // Number of threads to use for n elements
+    inline size_t workers(size_t n) {
+        return std::max<size_t>(1, std::min(max_threads(), n / grain()));
+    }
+
+    // Calls f(chunk, begin, end) for chunks contiguous ranges covering [0, n), one thread per chunk.
+    // The calling thread runs the first chunk.
+    template<typename F>
+    void for_chunks(size_t n, size_t chunks, F f) {
+        if (chunks <= 1) {
+            f(0, 0, n);
+            return;
+        }
+        std::vector<std::thread> threads;
+        threads.reserve(chunks - 1);
+        for (size_t chunk = 1; chunk < chunks; ++chunk) {
+            size_t begin = n * chunk / chunks, end = n * (chunk + 1) / chunks;
+            threads.emplace_back([&f, chunk, begin, end]() { f(chunk, begin, end); });
+        }
+        f(0, 0, n / chunks);
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    // Calls f(i) for every i in [begin, end)
+    template<typename F>
+    void for_each_index(size_t begin, size_t end, F f) {
+        size_t n = end > begin ? end - begin : 0;
+        for_chunks(n, workers(n), [&](size_t, size_t chunkBegin, size_t chunkEnd) {
+            for (size_t i = begin + chunkBegin; i < begin + chunkEnd; ++i)
+                f(i);
+        });
+    }
+
+    // Threads that are kept waiting between calls, for passes that run every step, where spawning
+    // threads each time would cost more than the work. One call runs at a time: a call made while
+    // another one is running, such as from inside a task, runs all of its tasks on the calling thread.
+    class Pool {
+    public:
+        ~Pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+
+        // Calls f(task) for every task in [0, tasks), each on its own thread, and returns once they're
+        // all done. The calling thread runs task 0. If tasks throw, the first exception is rethrown
+        // once every task has finished.
+        template<typename F>
+        void run(size_t tasks, F f) {
+            std::unique_lock<std::mutex> running(busy, std::defer_lock);
+            if (tasks <= 1 || in_task() || !running.try_lock()) {
+                for (size_t task = 0; task < tasks; ++task)
+                    f(task);
+                return;
+            }
+            while (threads.size() < tasks - 1)
+                threads.emplace_back([this, task = threads.size() + 1, seen = generation]() { work(task, seen); });
+
+            std::function<void(size_t)> call = [&f](size_t task) { f(task); };
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = &call;
+                helpers = remaining = tasks - 1;
+                ++generation;
+            }
+            wake.notify_all();
+            std::exception_ptr error;
+            in_task() = true;
+            try {
+                f(0);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            in_task() = false;
+
+            // The other tasks still use call, so they have to finish even if task 0 threw
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return remaining == 0; });
+            job = nullptr;
+            helpers = 0;
+            if (!error)
+                error = failure;
+            failure = nullptr;
+            lock.unlock();
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+    private:
+        // Whether this thread is running a task of the pool, in which case a call it makes runs on it
+        static bool& in_task() {
+            thread_local bool running = false;
+            return running;
+        }
+
+        // Loop of the pool's thread for task, which runs that task of every call with more than task tasks.
+        // seen is the last call it has been woken for.
+        void work(size_t task, size_t seen) {
+            in_task() = true;
+            for (;;) {
+                const std::function<void(size_t)>* call;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&]() { return stopping || generation != seen; });
+                    if (stopping)
+                        return;
+                    seen = generation;
+                    if (task > helpers)
+                        continue;
+                    call = job;
+                }
+                std::exception_ptr error;
+                try {
+                    (*call)(task);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error && !failure)
+                    failure = error;
+                if (--remaining == 0)
+                    done.notify_one();
+            }
+        }
+
+        std::mutex busy, mutex;
+        std::condition_variable wake, done;
+        std::vector<std::thread> threads;
+        const std::function<void(size_t)>* job = nullptr;
+        // Number of the current call's tasks that run on the pool's threads, and how many of them aren't done
+        size_t helpers = 0, remaining = 0;
+        size_t generation = 0;
+        bool stopping = false;
+        // First exception thrown by a task on the pool's threads during the current call
+        std::exception_ptr failure;
+    };
+
+    inline Pool& pool() {
+        static Pool shared;
+        return shared;
+    }
+
+    // Calls f(i) for every i in [0, n) on up to threads threads of the pool. Each thread takes the next
+    // index from a shared counter when it's done with the last one, so tasks of uneven cost still keep
+    // every thread busy.
+    template<typename F>
+    void for_each_dynamic(size_t n, size_t threads, F f) {
+        std::atomic<size_t> next(0);
+        size_t tasks = std::max<size_t>(1, std::min(threads, n));
+        pool().run(tasks, [&](size_t) {
+            for (size_t i = next++; i < n; i = next++)
+                f(i);
+        });
+    }
+
+    // Appends make(i) to out for every i in [0, n) such that keep(i), in order of i
+    template<typename T, typename Alloc, typename Keep, typename Make>
+    void append_if(std::vector<T, Alloc>& out, size_t n, Keep keep, Make make) {
+        size_t chunks = workers(n);
+        std::vector<size_t> offsets(chunks + 1, 0);
+        for_chunks(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            size_t count = 0;
+            for (size_t i = begin; i < end; ++i)
+                count += keep(i);
+            offsets[chunk + 1] = count;
+        });
+        offsets[0] = out.size();
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+            offsets[chunk + 1] += offsets[chunk];
+        out.resize(offsets[chunks]);
+        for_chunks(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            size_t next = offsets[chunk];
+            for (size_t i = begin; i < end; ++i) {
+                if (keep(i))
+                    out[next++] = make(i);
+            }
+        });
+    }
+
+    // Sample sort: splitters taken from a sorted sample cut v into one bucket per thread,
+    // every chunk of v scatters its elements to their buckets, and then the buckets are sorted independently.
+    template<typename T, typename Alloc, typename Less>
+    void sort(std::vector<T, Alloc>& v, Less less) {
+        size_t n = v.size();
+        size_t buckets = workers(n);
+        if (buckets <= 1) {
+            std::sort(v.begin(), v.end(), less);
+            return;
+        }
+
+        const size_t oversampling = 64;
+        std::vector<T> sample;
+        sample.reserve(buckets * oversampling);
+        for (size_t i = 0; i < buckets * oversampling; ++i)
+            sample.push_back(v[i * n / (buckets * oversampling)]);
+        std::sort(sample.begin(), sample.end(), less);
+        std::vector<T> splitters;
+        for (size_t bucket = 1; bucket < buckets; ++bucket)
+            splitters.push_back(sample[bucket * oversampling]);
+
+        // counts[chunk * buckets + bucket] is the number of elements of a chunk that go to a bucket.
+        std::vector<uint32_t> bucketOf(n);
+        std::vector<size_t> counts(buckets * buckets, 0);
+        for_chunks(n, buckets, [&](size_t chunk, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                size_t bucket = std::upper_bound(splitters.begin(), splitters.end(), v[i], less) - splitters.begin();
+                bucketOf[i] = bucket;
+                counts[chunk * buckets + bucket]++;
+            }
+        });
+
+        // Buckets are laid out in order, and within a bucket the chunks are too.
+        std::vector<size_t> offsets(buckets * buckets);
+        std::vector<size_t> bucketBegin(buckets + 1);
+        size_t total = 0;
+        for (size_t bucket = 0; bucket < buckets; ++bucket) {
+            bucketBegin[bucket] = total;
+            for (size_t chunk = 0; chunk < buckets; ++chunk) {
+                offsets[chunk * buckets + bucket] = total;
+                total += counts[chunk * buckets + bucket];
+            }
+        }
+        bucketBegin[buckets] = total;
+
+        std::vector<T, Alloc> out(n);
+        for_chunks(n, buckets, [&](size_t chunk, size_t begin, size_t end) {
+            size_t* offset = &offsets[chunk * buckets];
+            for (size_t i = begin; i < end; ++i)
+                out[offset[bucketOf[i]]++] = v[i];
+        });
+        for_chunks(buckets, buckets, [&](size_t, size_t begin, size_t end) {
+            for (size_t bucket = begin; bucket < end; ++bucket)
+                std::sort(out.begin() + bucketBegin[bucket], out.begin() + bucketBegin[bucket + 1], less);
+        });
+        v.swap(out);
+    }
+
+    // Number of elements of a that come first among the first diagonal elements of the stable merge of
+    // sorted ranges a and b, found by binary search along the merge path
+    template<typename Iterator, typename Less>
+    size_t merge_path(Iterator a, size_t na, Iterator b, size_t nb, size_t diagonal, Less less) {
+        size_t low = diagonal > nb ? diagonal - nb : 0, high = std::min(diagonal, na);
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (less(b[diagonal - mid - 1], a[mid]))
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        return low;
+    }
+
+    // std::merge of sorted ranges a and b into out, split into one piece of the output per thread.
+    // Ties take the element of a first, like std::merge.
+    template<typename Iterator, typename Output, typename Less>
+    void merge(Iterator a, size_t na, Iterator b, size_t nb, Output out, Less less) {
+        size_t n = na + nb;
+        for_chunks(n, workers(n), [&](size_t, size_t begin, size_t end) {
+            size_t fromA = merge_path(a, na, b, nb, begin, less), toA = merge_path(a, na, b, nb, end, less);
+            std::merge(a + fromA, a + toA, b + (begin - fromA), b + (end - toA), out + begin, less);
+        });
+    }
+
+    // Merge sort: one chunk per thread is sorted, and then runs are merged pairwise with parallel merges.
+    // Unlike sort, this gains from inputs that are already nearly in order.
+    template<typename T, typename Alloc, typename Less>
+    void merge_sort(std::vector<T, Alloc>& v, Less less) {
+        size_t n = v.size();
+        size_t chunks = workers(n);
+        if (chunks <= 1) {
+            std::sort(v.begin(), v.end(), less);
+            return;
+        }
+        for_chunks(n, chunks, [&](size_t, size_t begin, size_t end) {
+            std::sort(v.begin() + begin, v.begin() + end, less);
+        });
+
+        std::vector<T, Alloc> buffer(n);
+        for (size_t width = 1; width < chunks; width *= 2) {
+            for (size_t first = 0; first < chunks; first += 2 * width) {
+                size_t begin = n * first / chunks;
+                size_t middle = n * std::min(first + width, chunks) / chunks;
+                size_t end = n * std::min(first + 2 * width, chunks) / chunks;
+                merge(v.begin() + begin, middle - begin, v.begin() + middle, end - middle, buffer.begin() + begin, less);
+            }
+            v.swap(buffer);
+        }
+    }
+
+    // Floyd's heapify of an implicit tree, one level at a time from the bottom. Nodes on the same level
+    // have disjoint subtrees, so the sifts of a level run in parallel. first_child(i) is the index of the
+    // first child of node i, parentsEnd is one past the last node with a child, and settle(i) sifts
+    // node i down into its subtree.
+    template<typename FirstChild, typename Settle>
+    void heapify(size_t root, size_t parentsEnd, FirstChild first_child, Settle settle) {
+        std::vector<std::pair<size_t, size_t> > levels;
+        for (size_t begin = root, end = root + 1; begin < parentsEnd; begin = first_child(begin), end = first_child(end))
+            levels.push_back({ begin, std::min(end, parentsEnd) });
+        for (auto level = levels.rbegin(); level != levels.rend(); ++level)
+            for_each_index(level->first, level->second, settle);
+    }
+
+    // Parallel MinHeap::heapify
+    template<typename Heap>
+    void heapify(Heap& heap) {
+        if (heap.vec.size() <= heap.root() + 1)
+            return;
+        heapify(heap.root(), heap.parent(heap.vec.size() - 1) + 1,
+                [](size_t i) { return Heap::first_child(i); },
+                [&heap](size_t i) { heap.settle(i); });
+    }
+
+    // Parallel MinHeap::relink. The ref must tolerate concurrent set_ref_index calls for different elements,
+    // like RefTable does.
+    template<typename Heap>
+    void relink(Heap& heap) {
+        for_each_index(heap.root(), heap.vec.size(), [&heap](size_t i) {
+            heap.ref->set_ref_index(heap.vec[i].ref_index, i);
+        });
+    }
+}
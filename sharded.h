@@ -0,0 +1,199 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <limits>
+#include "heap.h"
+#include "successor.h"
+#include "parallel.h"
+
+// How KineticShards drives each kind of shard. A Slot owns a shard along with whatever else it needs
+// to run, and is never copied or moved once built.
+template<typename Shard>
+struct ShardTraits;
+
+template<typename T, size_t CertificateArity>
+struct ShardTraits<KineticHeap<T, CertificateArity> > {
+    using Value = T;
+    using Shard = KineticHeap<T, CertificateArity>;
+
+    // Kinetic heaps keep their own time
+    struct Slot {
+        Shard shard;
+
+        Slot(const std::vector<MovingObject<T> >& items) : shard(items) {}
+        Slot(const Slot&) = delete;
+
+        int& time() {
+            return shard.time;
+        }
+    };
+
+    static size_t size(const Shard& shard) {
+        return shard.size();
+    }
+
+    // Time after which fastforward has an event to process
+    static double next_event(const Shard& shard) {
+        return shard.next_event_time().value_or(std::numeric_limits<double>::infinity());
+    }
+
+    static std::optional<Trajectory> min(const Shard& shard) {
+        return shard.size() > 0 ? std::make_optional(shard.nodes[shard.root()].item) : std::nullopt;
+    }
+};
+
+template<typename T>
+struct ShardTraits<KineticSuccessor<T> > {
+    using Value = T;
+    using Shard = KineticSuccessor<T>;
+
+    // Kinetic successors read the time through a pointer, so the slot holds it
+    struct Slot {
+        int clock = 0;
+        Shard shard;
+
+        Slot(const std::vector<MovingObject<T> >& items) : shard(items, &clock) {}
+        Slot(const Slot&) = delete;
+
+        int& time() {
+            return clock;
+        }
+    };
+
+    static size_t size(const Shard& shard) {
+        return shard.items.size();
+    }
+
+    static double next_event(const Shard& shard) {
+        return shard.nextEventTime().value_or(std::numeric_limits<double>::infinity());
+    }
+
+    static std::optional<Trajectory> min(const Shard& shard) {
+        return !shard.items.empty() ? std::make_optional(shard.items[0]) : std::nullopt;
+    }
+};
+
+// Many independent kinetic heaps or successors moved forward together, such as one per spatial cell.
+// A queue of every shard's next event time picks the shards that have work on each fastforward, and
+// those are advanced in parallel. The other shards aren't touched, and only have their time caught up
+// when they're read. The min over all shards is a kinetic heap of the shards' mins.
+template<typename Shard>
+struct KineticShards {
+    using Traits = ShardTraits<Shard>;
+    using T = typename Traits::Value;
+    using Slot = typename Traits::Slot;
+
+    // A deque so that shards stay where they are as more get added
+    std::deque<Slot> slots;
+    // Next event time of each shard, keyed by shard index + 1. Shards without events aren't in it.
+    MinHeap<double, size_t, false, RefTable, std::less<double>, 4> schedule;
+    RefTable schedule_slots;
+    // The min of each non-empty shard, with the shard index as its value, and its handle in minima
+    // for each shard, or 0 if the shard is empty.
+    KineticHeap<size_t> minima;
+    std::vector<size_t> minimum_of;
+    int time;
+
+    // Number of times a shard was advanced because it had events, over the container's lifetime
+    size_t shard_advances = 0;
+
+    KineticShards() : schedule(&schedule_slots), schedule_slots(1), minima(std::vector<MovingObject<size_t> >()), time(0) {}
+
+    size_t size() const {
+        return slots.size();
+    }
+
+    // Adds a shard built from the given objects and returns its index.
+    // initialPosition is the position at time 0, like for the shards themselves.
+    size_t add_shard(const std::vector<MovingObject<T> >& items) {
+        size_t i = slots.size();
+        slots.emplace_back(items);
+        schedule_slots.index.push_back(0);
+        minimum_of.push_back(0);
+        advance(i);
+        reschedule(i);
+        return i;
+    }
+
+    // Brings shard i to the current time. That's O(1) if it has no events before then.
+    void advance(size_t i) {
+        Slot& slot = slots[i];
+        slot.shard.fastforward(time - slot.time());
+    }
+
+    // Gets shard i as of the current time. Call reschedule(i) after changing it.
+    Shard& shard(size_t i) {
+        advance(i);
+        return slots[i].shard;
+    }
+
+    // Updates the next event time and the min of shard i, which must be at the current time
+    void reschedule(size_t i) {
+        const Shard& current = slots[i].shard;
+        double next = Traits::next_event(current);
+        size_t index = schedule_slots.index[i + 1];
+        if (next != std::numeric_limits<double>::infinity()) {
+            if (index != 0)
+                schedule.update(index, next);
+            else
+                schedule.add(next, i + 1);
+        } else {
+            schedule.remove(index);
+        }
+
+        std::optional<Trajectory> min = Traits::min(current);
+        size_t handle = minimum_of[i];
+        if (!min) {
+            if (handle != 0)
+                minima.erase(handle);
+            minimum_of[i] = 0;
+        } else if (handle == 0) {
+            minimum_of[i] = minima.insert(MovingObject<size_t>(min->intercept, min->slope, i));
+        } else {
+            const Trajectory& tracked = minima.nodes[minima.node_of[handle]].item;
+            if (tracked.intercept != min->intercept || tracked.slope != min->slope)
+                minima.update_trajectory(handle, min->position(time), min->slope);
+        }
+    }
+
+    // Moves every shard timeToForward ahead. The shards with events before the new time are advanced
+    // in parallel, and a shard's cost doesn't depend on the others, so they are handed out one at a time.
+    // The schedule only knows about events ahead, so timeToForward must not be negative.
+    void fastforward(int timeToForward) {
+        time += timeToForward;
+        minima.fastforward(timeToForward);
+
+        std::vector<size_t> due;
+        schedule.ref_indexes_less(time, due);
+        size_t work = 0;
+        for (size_t& i : due) {
+            i -= 1;
+            work += Traits::size(slots[i].shard);
+        }
+        parallel::for_each_dynamic(due.size(), parallel::workers(work), [&](size_t k) {
+            advance(due[k]);
+        });
+        for (size_t i : due)
+            reschedule(i);
+        shard_advances += due.size();
+    }
+
+    // Shard index and handle within that shard of the lowest object across all shards
+    std::optional<std::pair<size_t, size_t> > min_handle() const {
+        std::optional<size_t> handle = minima.min_handle();
+        if (!handle)
+            return std::nullopt;
+        size_t i = minima.values[*handle];
+        return std::make_pair(i, static_cast<size_t>(Traits::min(slots[i].shard)->id));
+    }
+
+    std::optional<MovingObject<T> > min() {
+        std::optional<std::pair<size_t, size_t> > handle = min_handle();
+        if (!handle)
+            return std::nullopt;
+        return shard(handle->first).get(handle->second);
+    }
+};
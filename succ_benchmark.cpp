@@ -7,6 +7,7 @@
 #include <optional>
 #include <iostream>
 #include <time.h>
+#include <array>
 #include <experimental/random>
 #include <utility>
 #include <algorithm>
@@ -87,6 +88,8 @@ int main(int argc, char** argv) {
     }
     std::cout << "Naive heap total time:" << time_sum << "ms" << std::endl;
     std::cout << "Kinetic heap total time:" << kinetic_time_sum << "ms" << std::endl;
+    std::cout << "Kinetic events processed: " << kinetic_successor.eventsProcessed << ", rebuilds: " << kinetic_successor.rebuilds
+              << " (threshold " << kinetic_successor.rebuildThreshold() << " events per fastforward)" << std::endl;
 
     std::cout << "Initial positions: " << std::endl;
     for (int i = 0; i < positions.size(); i++){
@@ -1,189 +1,612 @@
+#pragma once
+
 #include <vector>
 #include <utility>
-#include <experimental/optional>
-#include <set>
-#include <unordered_map>
+#include <optional>
+#include <limits>
+#include <cstdint>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include "min_heap.h"
+#include "trajectory.h"
+#include "trajectory_store.h"
+#include "parallel.h"
+
+// Observer, if not void, gets told about every change of order through observer:
+// crossed(a, b) when a has just got in front of b, and reordered() after a re-sort, which changes
+// the order without going through crossings.
+// Coord is the type of positions, velocities and time, like for KineticHeap. Certificates are doubles whatever
+// it is, and only the time of the event that advanceToNextEvent stops at is kept exactly.
+template<typename T, typename Observer = void, typename Coord = int>
+struct KineticSuccessor {
+    using Traits = CoordinateTraits<Coord>;
+    using Failure = typename Traits::Failure;
+    using Trajectory = BasicTrajectory<Coord>;
+
+    // The trajectories in order. Each trajectory's id is its handle.
+    // The object at index i of the constructor's input gets handle i + 1.
+    std::vector<Trajectory> items;
+    // Payload of each handle
+    std::vector<T> values;
+    // ranks[h] is the index in items of handle h
+    std::vector<uint32_t> ranks;
+    // Slot i (1 <= i < items.size()) certifies that items[i - 1] comes before items[i].
+    // Certificates are keyed by slot, so invalidating one is an O(1) lookup in certificateSlots.
+    MinHeap<double, size_t, false, RefTable> certificates;
+    RefTable certificateSlots;
+    // Certificates of the slots whose pair is moving apart, which fail going back in time, latest first.
+    // Only kept when reversible is set.
+    MinHeap<double, size_t, false, RefTable, std::greater<double> > rewindCertificates;
+    RefTable rewindSlots;
+    Coord *time;
+    Observer *observer = nullptr;
+    // Whether fastforward can go back in time by processing rewind certificates. The first negative
+    // fastforward sets it and re-sorts; set it and call rebuild() up front to avoid that.
+    bool reversible = false;
+    // fastforward re-sorts at the target time instead of processing swaps one at a time
+    // once more than rebuildFactor * items.size() certificates fail within a single call.
+    double rebuildFactor = 0.5;
+    // Number of certificate failures processed and number of re-sorts, over the structure's lifetime.
+    size_t eventsProcessed = 0;
+    size_t rebuilds = 0;
+    // Approximate mode, when epsilon > 0: the order is only guaranteed to be right as of epsilon ago.
+    // Certificates failing within epsilon of the target time are left for later, and the ones failing
+    // within epsilon of each other are processed as one batch whose certificates are recomputed once.
+    // Going back to exact mode takes a rebuild().
+    double epsilon = 0;
+    // Number of batches, and of swaps made without going through the certificate queue because a batch
+    // handles the cascade of a failure on the spot, over the structure's lifetime.
+    size_t batches = 0;
+    size_t eventsSaved = 0;
+    // Set by advanceToNextEvent, whose event is usually between whole times: items is then in its order
+    // just after this time, and the queries on positions and the order use it instead of *time until
+    // fastforward moves past it. Positions of the objects handed out are still at *time.
+    // The time is kept exactly, since objects that meet right at it have to tie.
+    std::optional<Failure> eventTime;
+
+    double getCertificate(const Trajectory &a, const Trajectory &b) const {
+        if (b.slope > a.slope) { // they have already crossed each other
+            return -std::numeric_limits<double>::infinity();
+        }
+        return a.intersectionTime(b);
+    }
 
-template<typename T>
-struct MovingObject {
-    int initialPosition;
-    int velocity;
-    int *curtime;
-    T value;
-
-    // Constructor used as the default constructor for the kinetic heap
-    MovingObject() {}
+    // Adds the certificate for slot i. If its pair is moving apart, that's the time they last crossed,
+    // which is only kept when the structure is reversible.
+    void insertCertificate(size_t slot) {
+        const Trajectory &a = items[slot - 1], &b = items[slot];
+        double intersectionTime = getCertificate(a, b);
+        if (intersectionTime != -std::numeric_limits<double>::infinity()) {
+            certificates.add(intersectionTime, slot);
+        } else if (reversible && b.slope > a.slope) {
+            rewindCertificates.add(a.intersectionTime(b), slot);
+        }
+    }
 
-    // Constructor used for kinetic heap, since
-    // `curtime` is assigned at construction there
-    MovingObject(int ip, int v, T val) : initialPosition(ip), velocity(v), curtime(nullptr), value(val) {}
+    // Whether slot has a certificate in queue, whose slots are in table, that fails at exactly the given time
+    template<typename Queue>
+    static bool failsAt(const Queue &queue, const RefTable &table, size_t slot, double failure) {
+        size_t index = table.index[slot];
+        return index != 0 && queue.vec[index].t == failure;
+    }
 
-    MovingObject(int ip, int v, int *t, T val) : initialPosition(ip), velocity(v), curtime(t), value(val) {}
+    // Approximate mode's version of insertCertificate. The order can lag behind there, so a pair
+    // that's out of order at time at and will never cross is scheduled to swap at that time.
+    void insertLaggingCertificate(size_t slot, double at) {
+        const Trajectory &a = items[slot - 1], &b = items[slot];
+        double intersectionTime = getCertificate(a, b);
+        if (intersectionTime == -std::numeric_limits<double>::infinity()
+            && b.intercept + static_cast<double>(b.slope) * at < a.intercept + static_cast<double>(a.slope) * at) {
+            intersectionTime = at;
+        }
+        if (intersectionTime != -std::numeric_limits<double>::infinity()) {
+            certificates.add(intersectionTime, slot);
+        }
+    }
 
-    double getIntersectionTime(const MovingObject &other) const {
-        // Avoid returning NaN when both numerator and denominator are 0
-        if (velocity - other.velocity == 0)
-            return -std::numeric_limits<double>::infinity();
-        return (other.initialPosition - initialPosition * 1.0) / (velocity - other.velocity);
+    void removeCertificate(size_t slot) {
+        if (slot >= 1 && slot < items.size()) {
+            certificates.remove(certificateSlots.index[slot]);
+            rewindCertificates.remove(rewindSlots.index[slot]);
+        }
     }
 
-    int getPosition() const {
-        return initialPosition + velocity * (*curtime);
+    // must have at least one element
+    KineticSuccessor(const std::vector<MovingObject<T, Coord> > &itemsUnsorted, Coord *t)
+        : values(itemsUnsorted.size() + 1), ranks(itemsUnsorted.size() + 1), certificates(&certificateSlots),
+          certificateSlots(itemsUnsorted.size()), rewindCertificates(&rewindSlots), rewindSlots(itemsUnsorted.size()), time(t) {
+        items.resize(itemsUnsorted.size());
+        parallel::for_each_index(0, itemsUnsorted.size(), [&](size_t i) {
+            items[i] = itemsUnsorted[i].trajectory(i + 1);
+            values[i + 1] = itemsUnsorted[i].value;
+        });
+        parallel::sort(items, [this](const Trajectory &a, const Trajectory &b) {
+            return before(a, b);
+        });
+        buildCertificates();
     }
 
-    bool operator<(const MovingObject &other) const {
-        if (getPosition() == other.getPosition()) {
-            return value < other.value;
+    // Order at the current time. Ties in position keep their pre-crossing order, so the faster object comes first.
+    // This is the order that processing every failure before now produces. After advanceToNextEvent it's
+    // the order just after eventTime, where ties have already crossed, so the slower object comes first.
+    bool before(const Trajectory &a, const T &valueA, const Trajectory &b, const T &valueB) const {
+        if (eventTime) {
+            auto positionA = Traits::scaled_position(a, *eventTime);
+            auto positionB = Traits::scaled_position(b, *eventTime);
+            if (positionA != positionB)
+                return positionA < positionB;
+            if (a.slope != b.slope)
+                return a.slope < b.slope;
+            return valueA < valueB;
         }
-        return getPosition() < other.getPosition();
+        Coord positionA = a.position(*time);
+        Coord positionB = b.position(*time);
+        if (positionA != positionB)
+            return positionA < positionB;
+        if (a.slope != b.slope)
+            return a.slope > b.slope;
+        return valueA < valueB;
     }
 
-    bool operator==(const MovingObject &other) const {
-        return initialPosition == other.initialPosition && velocity == other.velocity && value == other.value;
+    bool before(const Trajectory &a, const Trajectory &b) const {
+        return before(a, values[a.id], b, values[b.id]);
     }
 
-};
+    // Whether a is before position at the time the order in items is for, which is eventTime if it's set.
+    // With orEqual, whether it's at or before it.
+    bool beforePosition(const Trajectory &a, Coord position, bool orEqual) const {
+        if (eventTime) {
+            auto positionA = Traits::scaled_position(a, *eventTime), bound = Traits::scaled(position, *eventTime);
+            return orEqual ? positionA <= bound : positionA < bound;
+        }
+        return orEqual ? a.position(*time) <= position : a.position(*time) < position;
+    }
 
-template<typename T>
-struct ObjectHasher {
-    int operator()(const MovingObject<T> &key) const {
-        return key.initialPosition * 31 + key.velocity;
+    // Same order at a fractional time
+    bool beforeAt(const Trajectory &a, const Trajectory &b, double t) const {
+        double positionA = a.intercept + static_cast<double>(a.slope) * t;
+        double positionB = b.intercept + static_cast<double>(b.slope) * t;
+        if (positionA != positionB)
+            return positionA < positionB;
+        if (a.slope != b.slope)
+            return a.slope > b.slope;
+        return values[a.id] < values[b.id];
     }
-};
 
-template<typename T>
-struct KineticSuccessor {
-    std::vector<MovingObject<T>> items;
-    std::set<std::pair<double, std::pair<MovingObject<T>, MovingObject<T>>>> certificates;
-    std::unordered_map<MovingObject<T>, int, ObjectHasher<T>> arrayLocations;
-    int *time;
+    // Recomputes every certificate and rank from the order in items.
+    // Every pass is split across threads for large inputs, see parallel.h.
+    void buildCertificates() {
+        size_t n = items.size();
+        size_t pairs = n > 0 ? n - 1 : 0;
+        certificates.clear();
+        rewindCertificates.clear();
+        std::vector<double> failures(n);
+        parallel::for_chunks(n, parallel::workers(n), [&](size_t, size_t begin, size_t end) {
+            std::fill(certificateSlots.index.begin() + begin, certificateSlots.index.begin() + end, 0);
+            std::fill(rewindSlots.index.begin() + begin, rewindSlots.index.begin() + end, 0);
+        });
+        // The kernels in simd take int coordinates laid out as arrays, and other coordinates get the scalar pass
+        if constexpr (std::is_same_v<Coord, int>) {
+            TrajectoryStore store;
+            store.resize(n);
+            parallel::for_chunks(n, parallel::workers(n), [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    store.set(i, items[i]);
+                }
+            });
+            parallel::for_chunks(pairs, parallel::workers(pairs), [&](size_t, size_t begin, size_t end) {
+                store.neighbour_failure_times(begin, end, failures.data());
+            });
+        } else {
+            parallel::for_each_index(0, pairs, [&](size_t i) {
+                failures[i] = failureTime(items[i], items[i + 1]);
+            });
+        }
+        parallel::append_if(certificates.vec, pairs,
+            [&](size_t i) { return failures[i] != -std::numeric_limits<double>::infinity(); },
+            [&](size_t i) { return MinHeap<double, size_t, false, RefTable>::Element {failures[i], i + 1}; });
+        parallel::heapify(certificates);
+        parallel::relink(certificates);
+        if (reversible) {
+            parallel::append_if(rewindCertificates.vec, pairs,
+                [&](size_t i) { return items[i + 1].slope > items[i].slope; },
+                [&](size_t i) {
+                    return MinHeap<double, size_t, false, RefTable, std::greater<double> >::Element {items[i].intersectionTime(items[i + 1]), i + 1};
+                });
+            parallel::heapify(rewindCertificates);
+            parallel::relink(rewindCertificates);
+        }
 
-    std::pair<double, std::pair<MovingObject<T>, MovingObject<T> > > getCertificate(MovingObject<T> a, MovingObject<T> b) {
-        double intersectionTime = a.getIntersectionTime(b);
+        parallel::for_each_index(0, n, [this](size_t i) {
+            ranks[items[i].id] = i;
+        });
+    }
 
-        if (b.velocity > a.velocity) { // they have already crossed each other
-            intersectionTime = -std::numeric_limits<double>::infinity();
-        }
-        return {intersectionTime, {a, b}};
+    // Re-sorts at the current time
+    void rebuild() {
+        eventTime.reset();
+        parallel::sort(items, [this](const Trajectory &a, const Trajectory &b) {
+            return before(a, b);
+        });
+        buildCertificates();
+        rebuilds++;
+        notifyReordered();
     }
 
-    void insertCertificate(MovingObject<T> a, MovingObject<T> b) {
-        auto certificate = getCertificate(a, b);
-        //std::cout << "inserting cert for " << a.value << " " << b.value << " time " << certificate.first << std::endl;
-        if (certificate.first != -std::numeric_limits<double>::infinity()) {
+    // Tells the observer that items[i] has just got in front of items[j]
+    void notifyCrossed(size_t i, size_t j) {
+        if constexpr (!std::is_void_v<Observer>) {
+            if (observer)
+                observer->crossed(items[i], items[j]);
+        }
+    }
 
-            //std::cout << " certs size " << certificates.size() << " item " << (*certificates.begin()).second.first.value << ' ' << (*certificates.begin()).second.second.value <<  std::endl;
-            //std::cout << "inserted " << std::endl;
-            certificates.insert(certificate);
-            //std::cout << " certs size " << certificates.size() << " item " << (*certificates.begin()).second.first.value << ' ' << (*certificates.begin()).second.second.value <<  std::endl;
-            
+    void notifyReordered() {
+        if constexpr (!std::is_void_v<Observer>) {
+            if (observer)
+                observer->reordered();
         }
     }
 
-    // must have at least one element
-    KineticSuccessor(std::vector<MovingObject<T> > itemsUnsorted, int *t) {
-        items = itemsUnsorted;
-        time = t;
+    // Number of certificate failures within one fastforward above which a re-sort is cheaper
+    size_t rebuildThreshold() const {
+        // Capped so that callers can add one without overflowing, even for an infinite factor
+        double threshold = rebuildFactor * items.size();
+        size_t cap = std::numeric_limits<size_t>::max() - 1;
+        return threshold < cap ? static_cast<size_t>(threshold) : cap;
+    }
 
-        sort(items.begin(), items.end());
+    // The object at index i of items
+    MovingObject<T, Coord> at(size_t i) const {
+        return MovingObject<T, Coord>(items[i], time, values[items[i].id]);
+    }
 
-        for (int i = 0; i < items.size() - 1; i++) {
-            insertCertificate(items[i], items[i + 1]);
-        }
+    // Whether items is sorted by position at the time the queries on positions are for. That always holds
+    // in exact mode, and in approximate mode once no failed certificate is left for later.
+    bool ordered() const {
+        double failure = certificates.min().value_or(std::numeric_limits<double>::infinity());
+        // Every certificate failing at eventTime has been processed in exact mode, and one that's left
+        // in approximate mode still has its pair in the order from before.
+        return eventTime ? failure > Traits::to_double(*eventTime) : failure >= *time;
+    }
 
-        for (int i = 0; i < items.size(); i++) {
-            arrayLocations[items[i]] = i;
+    // Index of m in items, or -1 if it isn't there. Binary searches on the current order, so this costs O(log n),
+    // unless the order lags behind in approximate mode, where it takes a scan.
+    int findLocation(const MovingObject<T, Coord> &m) const {
+        auto matches = [&](const Trajectory &a) {
+            return a.intercept == m.initialPosition && a.slope == m.velocity && values[a.id] == m.value;
+        };
+        if (!ordered()) {
+            auto it = std::find_if(items.begin(), items.end(), matches);
+            return it != items.end() ? static_cast<int>(it - items.begin()) : -1;
         }
+        Trajectory probe = m.trajectory(0);
+        auto it = std::lower_bound(items.begin(), items.end(), probe, [&](const Trajectory &a, const Trajectory &) {
+            return before(a, values[a.id], probe, m.value);
+        });
+        if (it == items.end() || !matches(*it))
+            return -1;
+        return it - items.begin();
     }
 
-    int findLocation(MovingObject<T> m) {
-        return (arrayLocations.find(m) != arrayLocations.end() ? arrayLocations[m] : -1);
+    std::optional<MovingObject<T, Coord>> findSuccessor(const MovingObject<T, Coord> &m) const {
+        int location = findLocation(m);
+        return (location != -1 && static_cast<size_t>(location) + 1 < items.size() ? std::make_optional(at(location + 1)) : std::nullopt);
     }
 
-    std::optional<MovingObject<T>> findSuccessor(MovingObject<T> m) {
-        return (findLocation(m) + 1 < items.size() ? std::make_optional(items[findLocation(m) + 1]) : std::nullopt);
+    MovingObject<T, Coord> get(size_t handle) const {
+        return at(ranks[handle]);
     }
 
-    //int counter = 0;
+    size_t rankOf(size_t handle) const {
+        return ranks[handle];
+    }
 
-    void fastforward(int timeToForward) {
-        *time += timeToForward;
+    // Handle of the object right after the given one, if there is one
+    std::optional<size_t> findSuccessor(size_t handle) const {
+        size_t next = ranks[handle] + 1;
+        return (next < items.size() ? std::make_optional<size_t>(items[next].id) : std::nullopt);
+    }
 
-        if (certificates.size() == 0) return;
+    std::optional<MovingObject<T, Coord>> findPredecessor(const MovingObject<T, Coord> &m) const {
+        int location = findLocation(m);
+        return (location > 0 ? std::make_optional(at(location - 1)) : std::nullopt);
+    }
 
-        auto cur = *certificates.begin();
-        auto curit = certificates.begin();
-        while (cur.first < *time) {
-            // swap them
-            MovingObject<T> firstObject = cur.second.first;
-            int firstLocation = arrayLocations[firstObject];
+    // Handle of the object right before the given one, if there is one
+    std::optional<size_t> findPredecessor(size_t handle) const {
+        size_t rank = ranks[handle];
+        return (rank > 0 ? std::make_optional<size_t>(items[rank - 1].id) : std::nullopt);
+    }
 
+    // Number of objects before the given position at the current time, which is the index in items
+    // of the first object at or after it. Binary searches on the current order, so this costs O(log n).
+    // If the order lags behind in approximate mode, this counts them in a scan instead.
+    size_t lowerBound(Coord position) const {
+        auto below = [&](const Trajectory &a) { return beforePosition(a, position, false); };
+        if (!ordered())
+            return std::count_if(items.begin(), items.end(), below);
+        return std::partition_point(items.begin(), items.end(), below) - items.begin();
+    }
 
-            certificates.erase(curit);
+    // Number of objects at or before the given position at the current time
+    size_t upperBound(Coord position) const {
+        auto notAbove = [&](const Trajectory &a) { return beforePosition(a, position, true); };
+        if (!ordered())
+            return std::count_if(items.begin(), items.end(), notAbove);
+        return std::partition_point(items.begin(), items.end(), notAbove) - items.begin();
+    }
 
-            //counter++;
+    // The objects with position in [low, high] at the current time, in order, as a view of items.
+    // Each trajectory's id is its handle. No copy is made, and the view stays valid until the order changes.
+    // The objects in range are only next to each other in items if it's ordered(), and otherwise this is nullopt.
+    std::optional<Span<Trajectory>> range(Coord low, Coord high) const {
+        if (!ordered())
+            return std::nullopt;
+        size_t first = lowerBound(low);
+        size_t last = std::max(first, upperBound(high));
+        return Span<Trajectory> { items.data() + first, last - first };
+    }
 
-            //if (counter % 1000000 == 0) std::cout << " at " << cur.first << " pos " << firstLocation << " " << firstObject.value << " certs size " << certificates.size() << std::endl;
+    // Number of certificates that have failed but are left for later in approximate mode
+    size_t deferredEvents() const {
+        return certificates.count_less(*time, std::numeric_limits<size_t>::max());
+    }
 
-            //std::cout << " certs size " << certificates.size() <<  std::endl;
-            //for (auto i : items) {
-            //    std::cout << i.initialPosition << ' ' << i.velocity << ' ' << i.value << " | " ;
-            //}
-            //std::cout << std::endl;
-            if (firstLocation > 0) {
-                certificates.erase(getCertificate(items[firstLocation - 1], items[firstLocation]));
+    // Processes the certificates failing before horizon in batches spanning epsilon each.
+    // Every failure in a batch is handled as of the end of its window: the pair swaps, and the swaps
+    // that cascade from it are made right away as long as some neighbouring pair is out of order
+    // at that time, instead of each becoming an event of its own.
+    void processBatches(double horizon, size_t threshold) {
+        size_t processed = 0;
+        std::vector<size_t> pending;
+        while (certificates.min().value_or(std::numeric_limits<double>::infinity()) < horizon) {
+            double end = std::min(certificates.min().value() + epsilon, horizon);
+            batches++;
+
+            while (certificates.min().value_or(std::numeric_limits<double>::infinity()) < end) {
+                if (processed > threshold) {
+                    rebuild();
+                    return;
+                }
+                eventsProcessed++;
+
+                size_t slot = certificates.min_ref_index().value();
+                certificates.remove_min();
+                size_t swaps = 0;
+                // Slots that might be out of order. A swap can only break the order of the slots next to it.
+                pending.push_back(slot);
+                while (!pending.empty()) {
+                    size_t i = pending.back();
+                    pending.pop_back();
+                    if (i < 1 || i >= items.size() || !beforeAt(items[i], items[i - 1], end))
+                        continue;
+                    removeCertificate(i - 1);
+                    removeCertificate(i);
+                    removeCertificate(i + 1);
+
+                    std::swap(items[i - 1], items[i]);
+                    ranks[items[i - 1].id] = i - 1;
+                    ranks[items[i].id] = i;
+                    notifyCrossed(i - 1, i);
+                    swaps++;
+
+                    // The swapped pair's own slot is included in case it was only scheduled
+                    // because insertLaggingCertificate found it out of order.
+                    for (size_t j = i - 1; j <= i + 1; j++) {
+                        if (j >= 1 && j < items.size()) {
+                            insertLaggingCertificate(j, end);
+                        }
+                    }
+                    pending.push_back(i - 1);
+                    pending.push_back(i + 1);
+                }
+                // The certificate failed early but its pair is still in order, so it needs a new one.
+                if (swaps == 0) {
+                    insertLaggingCertificate(slot, end);
+                }
+
+                processed += std::max<size_t>(swaps, 1);
+                eventsSaved += swaps > 1 ? swaps - 1 : 0;
             }
+        }
+    }
 
-            if (firstLocation + 1 < items.size() - 1) {
-                certificates.erase(getCertificate(items[firstLocation + 1], items[firstLocation + 2]));
-            }
+    // Same result as fastforward, without processing events one at a time: items is re-sorted at the
+    // target time by sorting one chunk per thread and merging them, which suits large time steps.
+    // Only the slots whose pair changed get new certificates, unless so many changed that
+    // recomputing all of them in parallel is cheaper. The result is exact even in approximate mode,
+    // and timeToForward can be negative.
+    void fastforwardBulk(Coord timeToForward) {
+        *time += timeToForward;
+        eventTime.reset();
+        parallel::merge_sort(items, [this](const Trajectory &a, const Trajectory &b) {
+            return before(a, b);
+        });
+
+        // ranks still holds the old order here, so a slot keeps its pair if neither object moved.
+        // A kept certificate that already failed can only be one deferred by approximate mode.
+        size_t n = items.size();
+        std::vector<size_t> changed;
+        parallel::append_if(changed, n > 0 ? n - 1 : 0,
+            [this](size_t i) {
+                size_t index = certificateSlots.index[i + 1];
+                return ranks[items[i].id] != i || ranks[items[i + 1].id] != i + 1
+                    || (index != 0 && certificates.vec[index].t < *time);
+            },
+            [](size_t i) { return i + 1; });
+        if (changed.size() > rebuildThreshold()) {
+            buildCertificates();
+            rebuilds++;
+            notifyReordered();
+            return;
+        }
 
-            //auto tmp = items[firstLocation];
-            //items[firstLocation] = items[firstLocation + 1];
-            //items[firstLocation + 1] = tmp;
-            std::swap(items[firstLocation], items[firstLocation + 1]);
+        parallel::for_each_index(0, n, [this](size_t i) {
+            ranks[items[i].id] = i;
+        });
+        for (size_t slot : changed) {
+            removeCertificate(slot);
+            insertCertificate(slot);
+        }
+        notifyReordered();
+    }
 
-            arrayLocations[items[firstLocation]]--;
-            arrayLocations[items[firstLocation + 1]]++;
+    // Moves timeToForward ahead, or back if it's negative. Going back costs the same per event
+    // as going forward, once the structure is reversible.
+    void fastforward(Coord timeToForward) {
+        *time += timeToForward;
+        if (eventTime && (timeToForward < 0 || *eventTime < Traits::whole(*time)))
+            eventTime.reset();
+        if (timeToForward < 0) {
+            rewind();
+            return;
+        }
 
-            //std::cout << " certs size " << certificates.size() <<  std::endl;
-            if (firstLocation > 0) {
-                insertCertificate(items[firstLocation - 1], items[firstLocation]);
-            }
+        // Re-sort straight away if the certificates that already fail outnumber the threshold,
+        // and otherwise give up on swaps as soon as the cascade they cause exceeds it.
+        // In approximate mode the certificates failing after horizon are left for later.
+        size_t threshold = rebuildThreshold();
+        double horizon = *time - epsilon;
+        if (certificates.count_less(horizon, threshold + 1) > threshold) {
+            rebuild();
+            return;
+        }
+        if (epsilon > 0) {
+            processBatches(horizon, threshold);
+            return;
+        }
 
-            if (firstLocation + 1 < items.size() - 1) {
-                insertCertificate(items[firstLocation + 1], items[firstLocation + 2]);
+        size_t processed = 0;
+        while (certificates.min().value_or(std::numeric_limits<double>::infinity()) < *time) {
+            std::pair<size_t, size_t> run = failingRun();
+            size_t length = run.second - run.first + 1;
+            if (processed + length > threshold) {
+                rebuild();
+                break;
             }
+            processed += length;
+            processEvent(run.first, run.second);
+        }
+    }
 
+    // Undoes the swaps that happened at or after the current time, latest first, with the same threshold
+    // as fastforward. That leaves items in their order just before the current time, like going forward does.
+    // Approximate mode only ever goes back by re-sorting.
+    void rewind() {
+        size_t threshold = rebuildThreshold();
+        double bound = std::nextafter(static_cast<double>(*time), -std::numeric_limits<double>::infinity());
+        if (!reversible || epsilon > 0 || rewindCertificates.count_less(bound, threshold + 1) > threshold) {
+            reversible = true;
+            rebuild();
+            return;
+        }
 
-            //std::cout << " certs size " << certificates.size() <<  std::endl;
-
-            // don't reinsert our cross into the certificates set, because they can't cross back
-
-            //std::cout << "done" << std::endl;
-
-            //std::cout << "done" << std::endl;
-            //std::cout << "done" << std::endl;
-            //for (auto i : items) {
-            //    std::cout << i.initialPosition << ' ' << i.velocity << ' ' << i.value << " | " ;
-            //}
-            //std::cout << std::endl;
-            //std::cout << " certs size " << certificates.size() <<  std::endl;
-            if (certificates.size() > 0) {
-                //std::cout << "yes begin" << std::endl;
-                cur = *certificates.begin();
-                curit = certificates.begin();
-                //std::cout << "acquired " << cur.first << std::endl;
-            } else {
+        size_t processed = 0;
+        while (rewindCertificates.min().value_or(-std::numeric_limits<double>::infinity()) >= *time) {
+            std::pair<size_t, size_t> run = failingRun(rewindCertificates, rewindSlots);
+            size_t length = run.second - run.first + 1;
+            if (processed + length > threshold) {
+                rebuild();
                 break;
             }
+            processed += length;
+            processEvent(run.first, run.second);
+        }
+    }
 
+    // Time after which the next certificate fails, which is when the order next changes, or nullopt if it never does.
+    // In approximate mode that's epsilon after the failure, when fastforward would get to it.
+    std::optional<double> nextEventTime() const {
+        std::optional<double> failure = certificates.min();
+        return failure ? std::make_optional(*failure + epsilon) : std::nullopt;
+    }
 
+    // Processes everything that happens at nextEventTime(), leaving items in their order just after
+    // that time, and returns the time. Simultaneous failures are all processed, and in approximate mode
+    // that's the batch starting epsilon earlier. The time moves to the last whole time not after the event,
+    // and fastforward carries on from there. Until then the queries are as of the event, see eventTime.
+    std::optional<double> advanceToNextEvent() {
+        std::optional<double> next = nextEventTime();
+        if (!next)
+            return std::nullopt;
+        // The exact time comes from the pair that fails first, before processing swaps it
+        Failure exact = Traits::at(*next);
+        if (epsilon > 0) {
+            processBatches(*next, std::numeric_limits<size_t>::max());
+        } else {
+            size_t slot = certificates.min_ref_index().value();
+            exact = Traits::failure(items[slot - 1], items[slot]);
+            while (certificates.min() == next) {
+                std::pair<size_t, size_t> run = failingRun();
+                processEvent(run.first, run.second);
+            }
         }
+        if (exact < Traits::whole(*time))
+            eventTime.reset();
+        else
+            eventTime = exact;
+        *time = std::max(*time, Traits::clock(exact));
+        return next;
     }
 
+    // Slots from first to last around the certificate that fails first, which all fail at the same time.
+    // Adjacent slots failing at the same time meet at the same point, so the whole run of objects
+    // from items[first - 1] to items[last] crosses at once.
+    std::pair<size_t, size_t> failingRun() const {
+        return failingRun(certificates, certificateSlots);
+    }
+
+    // Same for the first certificate of queue, whose slots are in table
+    template<typename Queue>
+    std::pair<size_t, size_t> failingRun(const Queue &queue, const RefTable &table) const {
+        double failure = queue.min().value();
+        size_t slot = queue.min_ref_index().value();
+        size_t first = slot, last = slot;
+        while (first > 1 && failsAt(queue, table, first - 1, failure))
+            first--;
+        while (last + 1 < items.size() && failsAt(queue, table, last + 1, failure))
+            last++;
+        return {first, last};
+    }
 
+    // Processes the crossing of a run from failingRun, going either way in time. The run ends up reversed,
+    // since the slopes are monotonic along it, and only the certificates at its two ends need recomputing,
+    // unless the structure is reversible and the pairs inside the run need certificates to cross back.
+    void processEvent(size_t first, size_t last) {
+        eventsProcessed += last - first + 1;
+
+        for (size_t i = first - 1; i <= last + 1; i++) {
+            removeCertificate(i);
+        }
 
+        std::reverse(items.begin() + (first - 1), items.begin() + (last + 1));
+        for (size_t i = first - 1; i <= last; i++) {
+            ranks[items[i].id] = i;
+        }
+        // Every object of the run crosses every other
+        if constexpr (!std::is_void_v<Observer>) {
+            for (size_t i = first - 1; i <= last; i++) {
+                for (size_t j = i + 1; j <= last; j++) {
+                    notifyCrossed(i, j);
+                }
+            }
+        }
+
+        // don't reinsert the crosses inside the run into the certificates, because they can't cross back
+        // going forward
+        if (first > 1) {
+            insertCertificate(first - 1);
+        }
+        if (reversible) {
+            for (size_t i = first; i <= last; i++) {
+                insertCertificate(i);
+            }
+        }
+        if (last + 1 < items.size()) {
+            insertCertificate(last + 1);
+        }
+    }
 };
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <optional>
+#include <limits>
+#include <random>
+#include "min_heap.h"
+#include "successor.h"
+
+// A kinetic successor structure whose membership can change.
+// The order is kept in a treap keyed by position at the current time, with the in-order
+// neighbours of every node threaded through prev/next so that successor queries are O(1).
+// Insertions and removals cost O(log n) and only touch the certificates next to them.
+template<typename T>
+struct KineticSuccessorTree {
+    struct Node {
+        // The object currently held by this node. Its id is the object's handle.
+        Trajectory trajectory;
+        uint32_t priority;
+        size_t parent, left, right;
+        // In-order neighbours
+        size_t prev, next;
+    };
+
+    // nodes[0] is the null node, so 0 can mean "none" like everywhere else in MinHeap.
+    std::vector<Node> nodes;
+    std::vector<size_t> freeNodes;
+    // Node holding the object for each handle. Objects move between nodes when they swap.
+    std::vector<size_t> nodeOf;
+    std::vector<size_t> freeHandles;
+    // Payload of each handle
+    std::vector<T> values;
+    size_t root = 0;
+    size_t count = 0;
+    // Node x certifies that its object comes before the object of nodes[x].next.
+    MinHeap<double, size_t, false, RefTable> certificates;
+    RefTable certificateSlots;
+    std::minstd_rand priorities;
+    int *time;
+
+    KineticSuccessorTree(int *t) : nodes(1), nodeOf(1), values(1), certificates(&certificateSlots), certificateSlots(1), time(t) {}
+
+    // The object at index i of itemsUnsorted gets handle i + 1.
+    KineticSuccessorTree(const std::vector<MovingObject<T> > &itemsUnsorted, int *t) : KineticSuccessorTree(t) {
+        for (const MovingObject<T> &item : itemsUnsorted) {
+            insert(item);
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Order at the current time. Ties in position keep their pre-crossing order, so the faster object comes first.
+    bool before(const Trajectory &a, const Trajectory &b) const {
+        int positionA = a.position(*time);
+        int positionB = b.position(*time);
+        if (positionA != positionB)
+            return positionA < positionB;
+        if (a.slope != b.slope)
+            return a.slope > b.slope;
+        return values[a.id] < values[b.id];
+    }
+
+    double getCertificate(const Trajectory &a, const Trajectory &b) const {
+        if (b.slope > a.slope) { // they have already crossed each other
+            return -std::numeric_limits<double>::infinity();
+        }
+        return a.intersectionTime(b);
+    }
+
+    // Adds the certificate of node x, unless it's the last node or its pair is moving apart
+    void insertCertificate(size_t x) {
+        if (x == 0 || nodes[x].next == 0)
+            return;
+        double intersectionTime = getCertificate(nodes[x].trajectory, nodes[nodes[x].next].trajectory);
+        if (intersectionTime != -std::numeric_limits<double>::infinity()) {
+            certificates.add(intersectionTime, x);
+        }
+    }
+
+    void removeCertificate(size_t x) {
+        if (x != 0) {
+            certificates.remove(certificateSlots.index[x]);
+        }
+    }
+
+    // Replaces child old of parent p (or the root, if p is 0) with child x
+    void replaceChild(size_t p, size_t old, size_t x) {
+        if (p == 0)
+            root = x;
+        else if (nodes[p].left == old)
+            nodes[p].left = x;
+        else
+            nodes[p].right = x;
+        if (x != 0)
+            nodes[x].parent = p;
+    }
+
+    // Rotates x above its parent. In-order neighbours don't change.
+    void rotateUp(size_t x) {
+        size_t p = nodes[x].parent;
+        replaceChild(nodes[p].parent, p, x);
+        if (nodes[p].left == x) {
+            nodes[p].left = nodes[x].right;
+            if (nodes[x].right != 0)
+                nodes[nodes[x].right].parent = p;
+            nodes[x].right = p;
+        } else {
+            nodes[p].right = nodes[x].left;
+            if (nodes[x].left != 0)
+                nodes[nodes[x].left].parent = p;
+            nodes[x].left = p;
+        }
+        nodes[p].parent = x;
+    }
+
+    size_t allocateNode() {
+        if (!freeNodes.empty()) {
+            size_t x = freeNodes.back();
+            freeNodes.pop_back();
+            return x;
+        }
+        nodes.emplace_back();
+        certificateSlots.index.push_back(0);
+        return nodes.size() - 1;
+    }
+
+    size_t allocateHandle() {
+        if (!freeHandles.empty()) {
+            size_t handle = freeHandles.back();
+            freeHandles.pop_back();
+            return handle;
+        }
+        nodeOf.push_back(0);
+        values.emplace_back();
+        return nodeOf.size() - 1;
+    }
+
+    // Adds an object in O(log n) and returns a handle to it that stays valid until it's erased
+    size_t insert(const MovingObject<T> &object) {
+        size_t handle = allocateHandle();
+        Trajectory trajectory = object.trajectory(handle);
+        values[handle] = object.value;
+
+        size_t parent = 0, prev = 0, next = 0;
+        bool goLeft = false;
+        for (size_t cur = root; cur != 0; ) {
+            parent = cur;
+            goLeft = before(trajectory, nodes[cur].trajectory);
+            if (goLeft) {
+                next = cur;
+                cur = nodes[cur].left;
+            } else {
+                prev = cur;
+                cur = nodes[cur].right;
+            }
+        }
+
+        size_t x = allocateNode();
+        nodes[x] = Node { trajectory, static_cast<uint32_t>(priorities()), parent, 0, 0, prev, next };
+        nodeOf[handle] = x;
+        if (parent == 0)
+            root = x;
+        else if (goLeft)
+            nodes[parent].left = x;
+        else
+            nodes[parent].right = x;
+        while (nodes[x].parent != 0 && nodes[nodes[x].parent].priority < nodes[x].priority)
+            rotateUp(x);
+
+        removeCertificate(prev);
+        if (prev != 0)
+            nodes[prev].next = x;
+        if (next != 0)
+            nodes[next].prev = x;
+        insertCertificate(prev);
+        insertCertificate(x);
+        count++;
+        return handle;
+    }
+
+    // Removes the object with the given handle in O(log n)
+    void erase(size_t handle) {
+        size_t x = nodeOf[handle];
+        size_t prev = nodes[x].prev, next = nodes[x].next;
+
+        removeCertificate(prev);
+        removeCertificate(x);
+        if (prev != 0)
+            nodes[prev].next = next;
+        if (next != 0)
+            nodes[next].prev = prev;
+        insertCertificate(prev);
+
+        // Rotate x down to a leaf, keeping the heap order on priorities, then cut it off
+        while (nodes[x].left != 0 || nodes[x].right != 0) {
+            size_t left = nodes[x].left, right = nodes[x].right;
+            if (right == 0 || (left != 0 && nodes[left].priority > nodes[right].priority))
+                rotateUp(left);
+            else
+                rotateUp(right);
+        }
+        replaceChild(nodes[x].parent, x, 0);
+
+        freeNodes.push_back(x);
+        nodeOf[handle] = 0;
+        freeHandles.push_back(handle);
+        count--;
+    }
+
+    MovingObject<T> get(size_t handle) const {
+        return MovingObject<T>(nodes[nodeOf[handle]].trajectory, time, values[handle]);
+    }
+
+    // Handle of the object right after the given one, if there is one
+    std::optional<size_t> findSuccessor(size_t handle) const {
+        size_t next = nodes[nodeOf[handle]].next;
+        return next != 0 ? std::make_optional<size_t>(nodes[next].trajectory.id) : std::nullopt;
+    }
+
+    // Handle of the object right before the given one, if there is one
+    std::optional<size_t> findPredecessor(size_t handle) const {
+        size_t prev = nodes[nodeOf[handle]].prev;
+        return prev != 0 ? std::make_optional<size_t>(nodes[prev].trajectory.id) : std::nullopt;
+    }
+
+    // Handle of the first object in order, if there is one
+    std::optional<size_t> first() const {
+        if (root == 0)
+            return std::nullopt;
+        size_t x = root;
+        while (nodes[x].left != 0)
+            x = nodes[x].left;
+        return nodes[x].trajectory.id;
+    }
+
+    void fastforward(int timeToForward) {
+        *time += timeToForward;
+
+        while (certificates.min().value_or(std::numeric_limits<double>::infinity()) < *time) {
+            size_t a = certificates.min_ref_index().value();
+            size_t b = nodes[a].next;
+            size_t prev = nodes[a].prev;
+
+            // The neighbouring certificates compare against the pair being swapped, so they're invalid too.
+            removeCertificate(prev);
+            removeCertificate(a);
+            removeCertificate(b);
+
+            // Nodes keep their place in the tree, and the objects trade nodes
+            std::swap(nodes[a].trajectory, nodes[b].trajectory);
+            nodeOf[nodes[a].trajectory.id] = a;
+            nodeOf[nodes[b].trajectory.id] = b;
+
+            // don't reinsert our cross into the certificates, because they can't cross back
+            insertCertificate(prev);
+            insertCertificate(b);
+        }
+    }
+};
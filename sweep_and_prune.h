@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "successor.h"
+#include "parallel.h"
+
+// A box moving without changing size: on every axis it spans [corner, corner + size] at time 0
+// and moves at velocity.
+template<size_t Dims>
+struct MovingBox {
+    std::array<int, Dims> corner;
+    std::array<int, Dims> size;
+    std::array<int, Dims> velocity;
+};
+
+// Kinetic sweep and prune: the set of pairs of boxes that overlap, kept up to date as they move.
+// Every axis has a kinetic sorted list of the boxes' endpoints on it. Two boxes can only start or stop
+// overlapping when an end of one crosses the other end of the other on some axis, so each such crossing
+// makes the pair a candidate, and once every axis is at the new time the candidates are checked on
+// all axes through the ranks of their endpoints, in O(Dims) each. A step costs O(events), and only a
+// re-sort of some axis falls back to sweeping that axis for every overlap.
+// Boxes that only touch overlap if they did just before, like in the order of KineticSuccessor,
+// and boxes touching while moving together always overlap.
+template<size_t Dims>
+struct KineticSweepAndPrune {
+    // Endpoints that crossed on one axis, as told by its KineticSuccessor
+    struct Crossings {
+        size_t boxes;
+        // Pairs of boxes from 0 whose overlap on this axis may have changed, smaller first
+        std::vector<std::pair<size_t, size_t> > candidates;
+        bool resorted = false;
+
+        // Only a lower end crossing the upper end of another box changes whether they overlap
+        void crossed(const Trajectory &a, const Trajectory &b) {
+            size_t x = a.id - 1, y = b.id - 1;
+            if ((x < boxes) != (y < boxes) && x % boxes != y % boxes)
+                candidates.push_back(std::minmax(x % boxes, y % boxes));
+        }
+
+        void reordered() {
+            resorted = true;
+        }
+    };
+
+    // The sorted endpoints of one axis. Endpoint handle i + 1 is the lower end of box i
+    // and handle boxes + i + 1 its upper end, which is also their value. Lower ends come first
+    // among endpoints at the same position moving at the same velocity.
+    struct Axis {
+        int clock = 0;
+        Crossings crossings;
+        KineticSuccessor<size_t, Crossings> endpoints;
+
+        Axis(const std::vector<MovingObject<size_t> > &items, size_t boxes)
+            : crossings{boxes, {}, false}, endpoints(items, &clock) {
+            endpoints.observer = &crossings;
+            // A re-sort costs a sweep of the axis, so only events are worth it
+            endpoints.rebuildFactor = std::numeric_limits<double>::infinity();
+        }
+        Axis(const Axis &) = delete;
+    };
+
+    size_t boxes;
+    // A deque so that axes stay where they are, since their successors point into them
+    std::deque<Axis> axes;
+    // Pairs of overlapping boxes by index in the input, smaller first
+    std::set<std::pair<size_t, size_t> > overlaps;
+    int time;
+
+    KineticSweepAndPrune(const std::vector<MovingBox<Dims> > &items) : boxes(items.size()), time(0) {
+        for (size_t d = 0; d < Dims; d++) {
+            std::vector<MovingObject<size_t> > ends;
+            ends.reserve(2 * boxes);
+            for (size_t i = 0; i < boxes; i++)
+                ends.push_back(MovingObject<size_t>(items[i].corner[d], items[i].velocity[d], i));
+            for (size_t i = 0; i < boxes; i++)
+                ends.push_back(MovingObject<size_t>(items[i].corner[d] + items[i].size[d], items[i].velocity[d], boxes + i));
+            axes.emplace_back(ends, boxes);
+        }
+        sweep();
+    }
+
+    // Whether boxes a and b overlap on axis d in its current order
+    bool overlap_on(size_t d, size_t a, size_t b) const {
+        const KineticSuccessor<size_t, Crossings> &endpoints = axes[d].endpoints;
+        return endpoints.rankOf(a + 1) < endpoints.rankOf(boxes + b + 1)
+            && endpoints.rankOf(b + 1) < endpoints.rankOf(boxes + a + 1);
+    }
+
+    bool overlap(size_t a, size_t b) const {
+        for (size_t d = 0; d < Dims; d++) {
+            if (!overlap_on(d, a, b))
+                return false;
+        }
+        return true;
+    }
+
+    // Finds every overlap from scratch by sweeping the first axis, in O(n + pairs overlapping on it)
+    void sweep() {
+        overlaps.clear();
+        if (Dims == 0)
+            return;
+        // Boxes whose lower end has been passed but not their upper end, and where each one is in it
+        std::vector<size_t> open, slot(boxes);
+        for (const Trajectory &end : axes[0].endpoints.items) {
+            size_t i = end.id - 1;
+            if (i < boxes) {
+                for (size_t other : open) {
+                    if (overlap(i, other))
+                        overlaps.insert(std::minmax(i, other));
+                }
+                slot[i] = open.size();
+                open.push_back(i);
+            } else {
+                size_t box = i - boxes;
+                open[slot[box]] = open.back();
+                slot[open.back()] = slot[box];
+                open.pop_back();
+            }
+        }
+    }
+
+    // Moves every box timeToForward ahead, advancing the axes in parallel, and then
+    // updates the overlaps of the candidate pairs.
+    void fastforward(int timeToForward) {
+        time += timeToForward;
+        parallel::for_each_dynamic(Dims, std::min(Dims, parallel::workers(2 * boxes * Dims)), [&](size_t d) {
+            axes[d].endpoints.fastforward(timeToForward);
+        });
+
+        bool reordered = false;
+        for (Axis &axis : axes)
+            reordered = reordered || axis.crossings.resorted;
+        if (reordered) {
+            sweep();
+        } else {
+            for (Axis &axis : axes) {
+                for (std::pair<size_t, size_t> pair : axis.crossings.candidates) {
+                    if (overlap(pair.first, pair.second))
+                        overlaps.insert(pair);
+                    else
+                        overlaps.erase(pair);
+                }
+            }
+        }
+        for (Axis &axis : axes) {
+            axis.crossings.candidates.clear();
+            axis.crossings.resorted = false;
+        }
+    }
+
+    // Number of endpoint crossings processed over the structure's lifetime, across all axes
+    size_t events_processed() const {
+        size_t events = 0;
+        for (const Axis &axis : axes)
+            events += axis.endpoints.eventsProcessed;
+        return events;
+    }
+};
@@ -1,6 +1,15 @@
 // The only purpose of this file is to test code.
 
 #include "heap.h"
+#include "successor_tree.h"
+#include "tournament.h"
+#include "envelope.h"
+#include "sharded.h"
+#include "top_k.h"
+#include "interval_heap.h"
+#include "sweep_and_prune.h"
+#include "leftist.h"
+#include "trajectory_store.h"
 #include <map>
 #include <string>
 #include <stdexcept>
@@ -9,6 +18,10 @@
 #include <set>
 #include <random>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #define assert1(cond) if (!(cond)) {throw std::logic_error("Assertion failed: " #cond);}
 #define assert2(cond, str) if (!(cond)) {throw std::logic_error(str);}
 
@@ -56,6 +69,100 @@ namespace test {
             assert1(heap.remove_min() == std::nullopt);
         }},
 
+        {"heap_heapify", [](){
+            std::mt19937 gen(5);
+            MinHeap<int, int, true> heap(nullptr);
+            std::vector<int> values;
+            for (int i = 0; i < 1000; ++i) {
+                values.push_back(gen() % 100);
+                heap.vec.push_back({values.back(), 0});
+            }
+            heap.heapify();
+            std::sort(values.begin(), values.end());
+            for (int value : values)
+                assert1(heap.remove_min() == std::make_optional(value));
+            assert1(heap.remove_min() == std::nullopt);
+        }},
+
+        {"heap_arity", [](){
+            auto check = [](auto heap, RefTable& slots) {
+                std::mt19937 gen(11);
+                std::multiset<int> expected;
+                std::vector<int> value_of(slots.index.size());
+                for (int step = 0; step < 3000; ++step) {
+                    size_t slot = 1 + gen() % (slots.index.size() - 1);
+                    if (slots.index[slot] != 0) {
+                        expected.erase(expected.find(value_of[slot]));
+                        heap.remove(slots.index[slot]);
+                        assert1(slots.index[slot] == 0);
+                    } else {
+                        value_of[slot] = gen() % 1000;
+                        expected.insert(value_of[slot]);
+                        heap.add(value_of[slot], slot);
+                    }
+                    assert1(heap.size() == expected.size());
+                    if (!expected.empty())
+                        assert1(heap.min() == std::make_optional(*expected.begin()));
+                    for (size_t i = heap.root(); i < heap.vec.size(); ++i)
+                        assert1(slots.index[heap.ref_index(i)] == i);
+                }
+                assert1(reinterpret_cast<uintptr_t>(heap.vec.data()) % 64 == 0);
+            };
+            RefTable slots2(200), slots4(200), slots8(200);
+            check(MinHeap<int, size_t, false, RefTable, std::less<int>, 2>(&slots2), slots2);
+            check(MinHeap<int, size_t, false, RefTable, std::less<int>, 4>(&slots4), slots4);
+            check(MinHeap<int, size_t, false, RefTable, std::less<int>, 8>(&slots8), slots8);
+        }},
+
+        {"simd_kernels_match_scalar", [](){
+            std::mt19937 gen(99);
+            std::uniform_int_distribution<int> dis(-1000, 1000);
+            std::vector<Trajectory> trajectories;
+            for (uint32_t i = 0; i < 103; ++i)
+                trajectories.push_back(Trajectory { dis(gen), dis(gen) % 7, i });
+            // Positions that overflow, which every level wraps around
+            trajectories.push_back(Trajectory { std::numeric_limits<int>::max(), 1000, 103 });
+            trajectories.push_back(Trajectory { std::numeric_limits<int>::min(), -1000, 104 });
+            trajectories.push_back(Trajectory { 0, std::numeric_limits<int>::max(), 105 });
+            TrajectoryStore store(trajectories.begin(), trajectories.end());
+            size_t n = store.size();
+
+            for (simd::Level level : { simd::Level::Scalar, simd::Level::SSE41, simd::Level::AVX2 }) {
+                if (!simd::supported(level))
+                    continue;
+                for (int t : { 0, 37, -5, 1 << 20 }) {
+                    std::vector<int> positions(n);
+                    simd::positions_at(level, store.intercepts.data(), store.slopes.data(), n, t, positions.data());
+                    for (size_t i = 0; i < n; ++i) {
+                        int64_t exact = static_cast<int64_t>(trajectories[i].intercept) + static_cast<int64_t>(trajectories[i].slope) * t;
+                        assert1(positions[i] == static_cast<int>(static_cast<uint32_t>(exact)));
+                    }
+                    for (size_t count : { n, n - 3, size_t(5), size_t(0) }) {
+                        int expected = count > 0 ? *std::min_element(positions.begin(), positions.begin() + count) : std::numeric_limits<int>::max();
+                        assert1(simd::min_position_at(level, store.intercepts.data(), store.slopes.data(), count, t) == expected);
+                    }
+                }
+
+                std::vector<double> failures(n - 1);
+                simd::failure_times(level, store.intercepts.data(), store.slopes.data(),
+                                    store.intercepts.data() + 1, store.slopes.data() + 1, n - 1, failures.data());
+                for (size_t i = 0; i + 1 < n; ++i) {
+                    const Trajectory& a = trajectories[i];
+                    const Trajectory& b = trajectories[i + 1];
+                    double expected = a.slope > b.slope
+                        ? (static_cast<double>(b.intercept) - a.intercept) / (static_cast<double>(a.slope) - b.slope)
+                        : -std::numeric_limits<double>::infinity();
+                    assert1(failures[i] == expected);
+                }
+            }
+
+            std::vector<int> positions(n), expected_positions(n);
+            store.positions_at(37, positions.data());
+            simd::scalar::positions_at(store.intercepts.data(), store.slopes.data(), n, 37, expected_positions.data());
+            assert1(positions == expected_positions);
+            assert1(store.min_position_at(37) == *std::min_element(expected_positions.begin(), expected_positions.end()));
+        }},
+
         {"kinetic_heap_new", [](){
             KineticHeap<int> heap(std::vector<MovingObject<int>>{
                 MovingObject(0, 1, 2),
@@ -117,6 +224,517 @@ namespace test {
             assert1(heap.min().value().value == 10);
         }},
 
+        {"kinetic_heap_rebuild_matches_events", [](){
+            std::mt19937 gen(12345);
+            std::uniform_int_distribution<int> dis(-50, 50);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 500; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), i));
+
+            KineticHeap<int> events(vec);
+            events.rebuild_factor = std::numeric_limits<double>::infinity();
+            KineticHeap<int> rebuilt(vec);
+            rebuilt.rebuild_factor = 0;
+            for (int step : std::array<int, 4>{1, 3, 50, 1000}) {
+                events.fastforward(step);
+                rebuilt.fastforward(step);
+                assert1(events.min().value().getPosition() == rebuilt.min().value().getPosition());
+            }
+            assert1(events.rebuilds == 0);
+            assert1(rebuilt.rebuilds == 4);
+            assert1(rebuilt.events_processed == 0);
+        }},
+
+        {"kinetic_heap_dynamic", [](){
+            std::mt19937 gen(777);
+            std::uniform_int_distribution<int> dis(-100, 100);
+            KineticHeap<int> heap(std::vector<MovingObject<int>>{
+                MovingObject(0, 1, 0),
+                MovingObject(10, -3, 1),
+            });
+            std::map<size_t, int> live {{1, 0}, {2, 1}};
+            int next_value = 2;
+
+            for (int step = 0; step < 2000; ++step) {
+                int op = gen() % 4;
+                if (op == 0 || live.size() < 2) {
+                    int value = next_value++;
+                    live[heap.insert(MovingObject<int>(dis(gen), dis(gen), value))] = value;
+                } else if (op == 1) {
+                    auto it = std::next(live.begin(), gen() % live.size());
+                    heap.erase(it->first);
+                    live.erase(it);
+                } else if (op == 2) {
+                    auto it = std::next(live.begin(), gen() % live.size());
+                    heap.update_trajectory(it->first, dis(gen), dis(gen));
+                } else {
+                    heap.fastforward(gen() % 3);
+                }
+
+                int best = std::numeric_limits<int>::max();
+                for (auto [handle, value] : live) {
+                    assert1(heap.get(handle).value == value);
+                    best = std::min(best, heap.get(handle).getPosition());
+                }
+                assert1(heap.size() == live.size());
+                assert1(heap.min().value().getPosition() == best);
+                assert1(heap.get(heap.min_handle().value()).value == heap.min().value().value);
+            }
+        }},
+
+        {"kinetic_heap_approximate", [](){
+            std::mt19937 gen(2024);
+            std::uniform_int_distribution<int> dis(-60, 60);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 400; ++i)
+                vec.push_back(MovingObject<int>(dis(gen) * 5, dis(gen), i));
+
+            KineticHeap<int> heap(vec);
+            heap.rebuild_factor = std::numeric_limits<double>::infinity();
+            heap.epsilon = 2;
+            int time = 0;
+            for (int step = 0; step < 40; ++step) {
+                time += gen() % 3;
+                heap.fastforward(time - heap.time);
+                // The min is right as of epsilon ago
+                if (time < 2)
+                    continue;
+                MovingObject<int> min = heap.min().value();
+                int lagging = std::numeric_limits<int>::max();
+                for (const MovingObject<int> &object : vec)
+                    lagging = std::min(lagging, object.initialPosition + object.velocity * (time - 2));
+                assert1(min.initialPosition + min.velocity * (time - 2) == lagging);
+            }
+            assert1(heap.batches > 0);
+
+            // A tiny epsilon catches up on everything that was left for later
+            heap.epsilon = 1e-9;
+            heap.fastforward(0);
+            assert1(heap.deferred_events() == 0);
+            int best = std::numeric_limits<int>::max();
+            for (const MovingObject<int> &object : vec)
+                best = std::min(best, object.initialPosition + object.velocity * time);
+            assert1(heap.min().value().getPosition() == best);
+
+            // Once the second object has overtaken the first, at the end of the first batch at 1/3 + 0.25,
+            // the third one overtakes it at 0.58333349, between that end and the end rounded up to a failure time
+            std::vector<MovingObject<int>> close { MovingObject<int>(0, 3, 1), MovingObject<int>(1, 0, 2),
+                                                   MovingObject<int>(583333500, -999999997, 3) };
+            KineticHeap<int> stepped(close), ahead(close);
+            stepped.epsilon = ahead.epsilon = 0.25;
+            stepped.fastforward(1);
+            assert1(stepped.rebuilds == 0 && stepped.min()->value == 3);
+            assert1(std::abs(*ahead.advance_to_next_event() - 7.0 / 12) < 1e-5);
+            assert1(ahead.min()->value == 2);
+        }},
+
+        {"kinetic_rewind_matches_brute_force", [](){
+            std::mt19937 gen(31337);
+            std::uniform_int_distribution<int> dis(-100, 100);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 300; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), i));
+
+            KineticHeap<int> heap(vec);
+            heap.rebuild_factor = std::numeric_limits<double>::infinity();
+            int successorTime = 0;
+            KineticSuccessor<int> successor(vec, &successorTime);
+            successor.rebuildFactor = std::numeric_limits<double>::infinity();
+
+            int time = 0;
+            for (int step = 0; step < 60; ++step) {
+                int forward = static_cast<int>(gen() % 21) - 10;
+                time += forward;
+                heap.fastforward(forward);
+                successor.fastforward(forward);
+
+                std::vector<int> positions;
+                for (const MovingObject<int> &object : vec)
+                    positions.push_back(object.initialPosition + object.velocity * time);
+                std::sort(positions.begin(), positions.end());
+                assert1(heap.min().value().getPosition() == positions[0]);
+                for (size_t i = 0; i < positions.size(); ++i)
+                    assert1(successor.at(i).getPosition() == positions[i]);
+                for (size_t handle = 1; handle <= vec.size(); ++handle)
+                    assert1(successor.findLocation(successor.get(handle)) == static_cast<int>(successor.rankOf(handle)));
+            }
+            // Only the first rewind rebuilds, and the rest go through events
+            assert1(heap.reversible && successor.reversible);
+            assert1(heap.rebuilds == 1);
+            assert1(successor.rebuilds == 1);
+        }},
+
+        {"kinetic_top_k_matches_brute_force", [](){
+            std::mt19937 gen(8080);
+            std::uniform_int_distribution<int> dis(-200, 200);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 500; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), i));
+
+            for (size_t k : {0, 1, 16, 499, 600}) {
+                KineticTopK<int> top(vec, k);
+                int time = 0;
+                for (int step = 0; step < 30; ++step) {
+                    int forward = gen() % 5;
+                    time += forward;
+                    top.fastforward(forward);
+
+                    std::vector<int> positions;
+                    for (const MovingObject<int> &object : vec)
+                        positions.push_back(object.initialPosition + object.velocity * time);
+                    std::sort(positions.begin(), positions.end());
+                    Span<Trajectory> lowest = top.top_k();
+                    assert1(lowest.size() == std::min(k, vec.size()));
+                    for (size_t i = 0; i < lowest.size(); ++i) {
+                        assert1(lowest[i].position(time) == positions[i]);
+                        assert1(top.get(lowest[i].id).value == vec[lowest[i].id - 1].value);
+                    }
+                    for (size_t handle = 1; handle <= vec.size(); ++handle)
+                        assert1(top.get(handle).getPosition() == vec[handle - 1].initialPosition + vec[handle - 1].velocity * time);
+                }
+            }
+        }},
+
+        {"kinetic_interval_heap_matches_brute_force", [](){
+            std::mt19937 gen(6060);
+            std::uniform_int_distribution<int> dis(-100, 100);
+            for (size_t n : {0, 1, 2, 3, 300, 301}) {
+                std::vector<MovingObject<int>> vec;
+                for (size_t i = 0; i < n; ++i)
+                    vec.push_back(MovingObject<int>(dis(gen), dis(gen), static_cast<int>(i)));
+
+                KineticIntervalHeap<int> heap(vec);
+                int time = 0;
+                for (int step = 0; step < 30; ++step) {
+                    int forward = gen() % 5;
+                    time += forward;
+                    heap.fastforward(forward);
+                    if (n == 0) {
+                        assert1(heap.min() == std::nullopt && heap.max() == std::nullopt);
+                        continue;
+                    }
+                    int lowest = std::numeric_limits<int>::max(), highest = std::numeric_limits<int>::min();
+                    for (const MovingObject<int> &object : vec) {
+                        lowest = std::min(lowest, object.initialPosition + object.velocity * time);
+                        highest = std::max(highest, object.initialPosition + object.velocity * time);
+                    }
+                    assert1(heap.min().value().getPosition() == lowest);
+                    assert1(heap.max().value().getPosition() == highest);
+                    assert1(heap.get(heap.max_handle().value()).value == heap.max().value().value);
+                }
+            }
+        }},
+
+        {"kinetic_successor_range_queries", [](){
+            std::mt19937 gen(2468);
+            std::uniform_int_distribution<int> dis(-100, 100);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 300; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen) / 10, i));
+
+            int time = 0;
+            KineticSuccessor<int> successor(vec, &time);
+            for (int step = 0; step < 20; ++step) {
+                successor.fastforward(gen() % 4);
+                int low = dis(gen) * 2, high = low + static_cast<int>(gen() % 100);
+
+                Span<Trajectory> found = *successor.range(low, high);
+                size_t expected = 0;
+                for (const MovingObject<int> &object : vec) {
+                    int position = object.initialPosition + object.velocity * time;
+                    expected += position >= low && position <= high;
+                }
+                assert1(found.size() == expected);
+                for (const Trajectory &item : found) {
+                    assert1(item.position(time) >= low && item.position(time) <= high);
+                    assert1(successor.get(item.id).value == vec[item.id - 1].value);
+                }
+                assert1(successor.range(high, low)->empty());
+
+                for (size_t handle = 1; handle <= vec.size(); ++handle) {
+                    std::optional<size_t> before = successor.findPredecessor(handle);
+                    assert1(before.has_value() == (successor.rankOf(handle) > 0));
+                    if (before)
+                        assert1(successor.findSuccessor(*before) == std::make_optional(handle));
+                }
+                std::optional<MovingObject<int>> first = successor.findPredecessor(successor.at(1));
+                assert1(first && first->value == successor.at(0).value);
+            }
+        }},
+
+        {"kinetic_sweep_and_prune_matches_brute_force", [](){
+            auto check = [](auto boxes, int seed) {
+                constexpr size_t Dims = std::tuple_size<decltype(boxes[0].corner)>::value;
+                std::mt19937 gen(seed);
+                std::uniform_int_distribution<int> corner(-100, 100), size(0, 30), velocity(-5, 5);
+                for (auto &box : boxes) {
+                    for (size_t d = 0; d < Dims; ++d) {
+                        box.corner[d] = corner(gen);
+                        box.size[d] = size(gen);
+                        box.velocity[d] = velocity(gen);
+                    }
+                }
+                KineticSweepAndPrune<Dims> sweep(boxes);
+                int time = 0;
+                for (int step = 0; step < 40; ++step) {
+                    // Every tenth step goes back. The first one re-sorts the axes, which sweeps them again,
+                    // and the later ones go back through events.
+                    int forward = step % 10 == 9 ? -1 - static_cast<int>(gen() % 6) : static_cast<int>(gen() % 4);
+                    time += forward;
+                    sweep.fastforward(forward);
+                    if (step == 9)
+                        for (size_t d = 0; d < Dims; ++d)
+                            assert1(sweep.axes[d].endpoints.rebuilds == 1);
+
+                    // Boxes that touch are left out, since whether they count depends on where they're going
+                    size_t strict = 0;
+                    for (size_t a = 0; a < boxes.size(); ++a) {
+                        for (size_t b = a + 1; b < boxes.size(); ++b) {
+                            bool overlap = true, touch = false;
+                            for (size_t d = 0; d < Dims; ++d) {
+                                int lowA = boxes[a].corner[d] + boxes[a].velocity[d] * time, highA = lowA + boxes[a].size[d];
+                                int lowB = boxes[b].corner[d] + boxes[b].velocity[d] * time, highB = lowB + boxes[b].size[d];
+                                overlap = overlap && lowA <= highB && lowB <= highA;
+                                touch = touch || lowA == highB || lowB == highA;
+                            }
+                            if (!touch) {
+                                assert1(sweep.overlaps.count({a, b}) == (overlap ? 1u : 0u));
+                                strict += overlap;
+                            }
+                        }
+                    }
+                    assert1(sweep.overlaps.size() >= strict);
+                }
+                assert1(sweep.events_processed() > 0);
+                for (size_t d = 0; d < Dims; ++d)
+                    assert1(sweep.axes[d].endpoints.rebuilds == 1);
+            };
+            check(std::vector<MovingBox<2>>(150), 17);
+            check(std::vector<MovingBox<3>>(150), 18);
+        }},
+
+        {"kinetic_leftist_forest_matches_brute_force", [](){
+            std::mt19937 gen(1357);
+            std::uniform_int_distribution<int> dis(-100, 100);
+            KineticLeftistForest<int> forest;
+            // Handles in each heap
+            std::vector<std::set<size_t>> members;
+            int next_value = 0;
+            auto random_objects = [&](size_t count) {
+                std::vector<MovingObject<int>> objects;
+                for (size_t i = 0; i < count; ++i)
+                    objects.push_back(MovingObject<int>(dis(gen), dis(gen), next_value++));
+                return objects;
+            };
+
+            for (int step = 0; step < 600; ++step) {
+                int op = gen() % 6;
+                size_t heap = members.empty() ? 0 : gen() % members.size();
+                if (op == 0 || members.empty()) {
+                    size_t first = forest.node_of.size();
+                    std::vector<MovingObject<int>> objects = random_objects(gen() % 40);
+                    assert1(forest.add_heap(objects) == members.size());
+                    members.emplace_back();
+                    for (size_t i = 0; i < objects.size(); ++i)
+                        members.back().insert(first + i);
+                } else if (op == 1) {
+                    members[heap].insert(forest.insert(heap, random_objects(1)[0]));
+                } else if (op == 2) {
+                    size_t other = gen() % members.size();
+                    forest.meld(heap, other);
+                    if (other != heap) {
+                        members[heap].insert(members[other].begin(), members[other].end());
+                        members[other].clear();
+                    }
+                } else if (op == 3) {
+                    int pivot = dis(gen);
+                    size_t split = forest.split(heap, [&](const MovingObject<int> &object) {
+                        return object.getPosition() < pivot;
+                    });
+                    assert1(split == members.size());
+                    members.emplace_back();
+                    for (auto it = members[heap].begin(); it != members[heap].end(); ) {
+                        if (forest.get(*it).getPosition() < pivot) {
+                            ++it;
+                        } else {
+                            members.back().insert(*it);
+                            it = members[heap].erase(it);
+                        }
+                    }
+                } else if (op == 4 && !members[heap].empty()) {
+                    size_t handle = forest.min_handle(heap).value();
+                    forest.pop_min(heap);
+                    assert1(members[heap].erase(handle) == 1);
+                } else {
+                    forest.fastforward(gen() % 3);
+                }
+
+                for (size_t h = 0; h < members.size(); ++h) {
+                    assert1(forest.size(h) == members[h].size());
+                    if (members[h].empty()) {
+                        assert1(forest.min(h) == std::nullopt);
+                        continue;
+                    }
+                    int best = std::numeric_limits<int>::max();
+                    for (size_t handle : members[h])
+                        best = std::min(best, forest.get(handle).getPosition());
+                    assert1(forest.min(h).value().getPosition() == best);
+                }
+            }
+            // Every node is at or after its parent, and the leftist shape holds
+            for (size_t i = 1; i < forest.nodes.size(); ++i) {
+                const auto &node = forest.nodes[i];
+                if (forest.node_of[node.item.id] != i)
+                    continue;
+                if (node.parent != 0)
+                    assert1(forest.nodes[node.parent].item.position(forest.time) <= node.item.position(forest.time));
+                assert1(forest.nodes[node.left].rank >= forest.nodes[node.right].rank);
+            }
+            assert1(forest.events_processed > 0);
+        }},
+
+        {"crossing_time_exact", [](){
+            using Time = CoordinateTraits<int>::Failure;
+            // 1/3 and 333333333/1000000000 are the same double after division but not the same time
+            assert1(Time({1, 3}) > Time({333333333, 1000000000}));
+            assert1(Time({2, 6}) == Time({1, 3}));
+            assert1(Time({-7, 2}).floor() == -4);
+            assert1(Time({7, 2}).floor() == 3);
+            assert1(Time::at(1.5) == Time({3, 2}));
+            assert1(sizeof(Time) == 12);
+        }},
+
+        {"kinetic_heap_wide_coordinates", [](){
+            std::mt19937 gen(4242);
+            std::uniform_int_distribution<int64_t> ip(-(int64_t(1) << 40), int64_t(1) << 40);
+            std::uniform_int_distribution<int64_t> v(-(int64_t(1) << 20), int64_t(1) << 20);
+            std::vector<MovingObject<int, int64_t>> vec;
+            for (int i = 0; i < 300; ++i)
+                vec.push_back(MovingObject<int, int64_t>(ip(gen), v(gen), i));
+
+            KineticHeap<int, 4, int64_t> heap(vec);
+            int64_t time = 0;
+            for (int step = 0; step < 40; ++step) {
+                int64_t forward = int64_t(1) << (gen() % 22);
+                time += forward;
+                heap.fastforward(forward);
+                int64_t best = std::numeric_limits<int64_t>::max();
+                for (const MovingObject<int, int64_t> &object : vec)
+                    best = std::min(best, object.initialPosition + object.velocity * time);
+                assert1(heap.min().value().getPosition() == best);
+            }
+        }},
+
+        {"kinetic_heap_floating_coordinates", [](){
+            std::mt19937 gen(99);
+            std::uniform_real_distribution<double> dis(-100, 100);
+            std::vector<MovingObject<int, double>> vec;
+            for (int i = 0; i < 300; ++i)
+                vec.push_back(MovingObject<int, double>(dis(gen), dis(gen), i));
+
+            KineticHeap<int, 4, double> heap(vec);
+            double time = 0;
+            for (int step = 0; step < 40; ++step) {
+                double forward = (gen() % 100) / 64.0;
+                time += forward;
+                heap.fastforward(forward);
+                double best = std::numeric_limits<double>::infinity();
+                for (const MovingObject<int, double> &object : vec)
+                    best = std::min(best, object.initialPosition + object.velocity * time);
+                assert1(std::abs(heap.min().value().getPosition() - best) < 1e-9);
+            }
+        }},
+
+        {"kinetic_successor_coordinates", [](){
+            auto check = [](auto &vec, auto &time, auto step) {
+                KineticSuccessor succ(vec, &time);
+                std::mt19937 gen(8);
+                for (int i = 0; i < 40; ++i) {
+                    succ.fastforward(step * (gen() % 64));
+                    for (size_t k = 0; k + 1 < succ.items.size(); ++k)
+                        assert1(succ.items[k].position(time) <= succ.items[k + 1].position(time));
+                    for (const auto &object : vec)
+                        assert1(succ.at(succ.findLocation(object)).value == object.value);
+                    assert1(succ.lowerBound(succ.at(7).getPosition()) <= 7 && succ.upperBound(succ.at(7).getPosition()) > 7);
+                }
+            };
+
+            std::mt19937 gen(4243);
+            std::uniform_int_distribution<int64_t> ip(-(int64_t(1) << 40), int64_t(1) << 40);
+            std::uniform_int_distribution<int64_t> v(-(int64_t(1) << 20), int64_t(1) << 20);
+            int64_t wideTime = 0;
+            std::vector<MovingObject<int, int64_t>> wide;
+            for (int i = 0; i < 300; ++i)
+                wide.push_back(MovingObject<int, int64_t>(ip(gen), v(gen), &wideTime, i));
+            check(wide, wideTime, int64_t(1) << 15);
+
+            std::uniform_real_distribution<double> dis(-100, 100);
+            double floatingTime = 0;
+            std::vector<MovingObject<int, double>> floating;
+            for (int i = 0; i < 300; ++i)
+                floating.push_back(MovingObject<int, double>(dis(gen), dis(gen), &floatingTime, i));
+            check(floating, floatingTime, 1 / 64.0);
+        }},
+
+        {"kinetic_tournament_takeovers", [](){
+            KineticTournament<int> tournament(std::vector<MovingObject<int>>{
+                MovingObject(0, 1, 2),
+                MovingObject(10, -3, 3),
+                MovingObject(20, -6, 4),
+            });
+            assert1(tournament.min().value().value == 2);
+            tournament.fastforward(3);
+            assert1(tournament.min().value().value == 3);
+            tournament.fastforward(1);
+            assert1(tournament.min().value().value == 4);
+            assert1(KineticTournament<int>(std::vector<MovingObject<int>>{}).min() == std::nullopt);
+        }},
+
+        {"kinetic_tournament_matches_heap", [](){
+            std::mt19937 gen(4242);
+            std::uniform_int_distribution<int> dis(-200, 200);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 777; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), i));
+
+            KineticTournament<int> tournament(vec);
+            KineticHeap<int> heap(vec);
+            int time = 0;
+            for (int step : std::array<int, 6>{1, 1, 2, 5, 40, 1000}) {
+                tournament.fastforward(step);
+                heap.fastforward(step);
+                time += step;
+                int best = std::numeric_limits<int>::max();
+                for (const MovingObject<int> &object : vec)
+                    best = std::min(best, object.initialPosition + object.velocity * time);
+                assert1(tournament.min().value().getPosition() == best);
+                assert1(heap.min().value().getPosition() == best);
+            }
+        }},
+
+        {"kinetic_envelope_matches_brute_force", [](){
+            std::mt19937 gen(99);
+            std::uniform_int_distribution<int> dis(-30, 30);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 300; ++i)
+                vec.push_back(MovingObject<int>(dis(gen) * 20, dis(gen), i));
+            vec.push_back(MovingObject<int>(-600, 30, 300)); // Parallel to and tied with another line
+
+            KineticEnvelope<int> envelope(vec);
+            assert1(KineticEnvelope<int>(std::vector<MovingObject<int>>{}).min_at(0) == std::nullopt);
+            for (int pass = 0; pass < 2; ++pass) {
+                for (int t = -100; t <= 100; ++t) {
+                    int best = std::numeric_limits<int>::max();
+                    for (const MovingObject<int> &object : vec)
+                        best = std::min(best, object.initialPosition + object.velocity * t);
+                    MovingObject<int> min = envelope.min_at(t).value();
+                    assert1(min.initialPosition + min.velocity * t == best);
+                    assert1(envelope.min_position_at(t).value() == best);
+                    assert1(envelope.sweep_min_handle_at(t) == envelope.min_handle_at(t));
+                }
+            }
+        }},
+
         {"kinetic_successor_parallel", [](){
 
             int time = 0;   
@@ -144,13 +762,452 @@ namespace test {
             }
             std::cout << std::endl;*/
             for (int i = 0; i < vec.size(); i++) {
-                std::cout << vec[i].getPosition() << ' ' << succ.items[i].getPosition() << std::endl;
-                if (vec[i].value != succ.items[i].value) {
+                std::cout << vec[i].getPosition() << ' ' << succ.at(i).getPosition() << std::endl;
+                if (vec[i].value != succ.at(i).value) {
                     assert1(false);
                 }
             }
         }},
 
+        {"kinetic_successor_rebuild_matches_events", [](){
+            // Small integer grid, so many objects meet at the same place at the same time
+            std::mt19937 gen(4242);
+            std::uniform_int_distribution<int> dis(-20, 20);
+            int eventTime = 0, rebuildTime = 0;
+            std::vector<MovingObject<int>> eventVec, rebuildVec;
+            for (int i = 0; i < 300; ++i) {
+                int ip = dis(gen), v = dis(gen);
+                eventVec.push_back(MovingObject<int>(ip, v, &eventTime, i));
+                rebuildVec.push_back(MovingObject<int>(ip, v, &rebuildTime, i));
+            }
+
+            KineticSuccessor events(eventVec, &eventTime);
+            events.rebuildFactor = std::numeric_limits<double>::infinity();
+            KineticSuccessor rebuilt(rebuildVec, &rebuildTime);
+            rebuilt.rebuildFactor = 0;
+            for (int step : std::array<int, 4>{1, 2, 7, 40}) {
+                events.fastforward(step);
+                rebuilt.fastforward(step);
+                for (int i = 0; i < static_cast<int>(events.items.size()); i++)
+                    assert1(events.at(i).value == rebuilt.at(i).value);
+                for (int i = 0; i < static_cast<int>(events.items.size()); i++)
+                    assert1(rebuilt.findLocation(rebuilt.at(i)) == i);
+            }
+            assert1(events.rebuilds == 0);
+            assert1(rebuilt.rebuilds == 4);
+        }},
+
+        {"kinetic_successor_simultaneous_crossing", [](){
+            // Every object passes through position 0 at time 10
+            int time = 0;
+            std::vector<MovingObject<int>> vec;
+            for (int v = 1; v <= 8; ++v)
+                vec.push_back(MovingObject<int>(-10 * v, v, &time, v));
+            vec.push_back(MovingObject<int>(-5, 0, &time, 0));
+
+            KineticSuccessor succ(vec, &time);
+            succ.rebuildFactor = std::numeric_limits<double>::infinity();
+            succ.fastforward(11);
+            // 8 separate crossings of the stationary object, and then the 7 certificates between
+            // the objects meeting at 0 make one reversal instead of 28 swaps.
+            assert1(succ.eventsProcessed == 8 + 7);
+            for (int i = 0; i < static_cast<int>(succ.items.size()); ++i)
+                assert1(succ.at(i).value == i);
+            for (int i = 0; i < static_cast<int>(succ.items.size()); ++i)
+                assert1(succ.findLocation(succ.at(i)) == i);
+        }},
+
+        {"kinetic_successor_approximate", [](){
+            int time = 0;
+            std::mt19937 gen(31337);
+            std::uniform_int_distribution<int> dis(-20, 20);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 300; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), &time, i));
+
+            KineticSuccessor succ(vec, &time);
+            succ.rebuildFactor = std::numeric_limits<double>::infinity();
+            succ.epsilon = 1.5;
+            // While the order lags, the queries on positions still count and find right, and range refuses
+            auto checkQueries = [&]() {
+                for (int position : std::array<int, 3>{-300, 0, 250}) {
+                    size_t below = 0, notAbove = 0;
+                    for (const MovingObject<int> &object : vec) {
+                        below += object.getPosition() < position;
+                        notAbove += object.getPosition() <= position;
+                    }
+                    assert1(succ.lowerBound(position) == below && succ.upperBound(position) == notAbove);
+                }
+                for (size_t handle = 1; handle <= vec.size(); ++handle)
+                    assert1(succ.findLocation(vec[handle - 1]) == static_cast<int>(succ.rankOf(handle)));
+                assert1(succ.range(-300, 250).has_value() == succ.ordered());
+            };
+            bool lagged = false;
+            for (int step : std::array<int, 5>{1, 1, 3, 10, 40}) {
+                succ.fastforward(step);
+                checkQueries();
+                lagged = lagged || !succ.ordered();
+            }
+            assert1(lagged);
+            assert1(succ.batches > 0);
+            assert1(succ.eventsSaved > 0);
+
+            succ.epsilon = 1e-9;
+            succ.fastforward(0);
+            assert1(succ.deferredEvents() == 0);
+            assert1(succ.ordered());
+            checkQueries();
+            for (size_t i = 1; i < succ.items.size(); ++i)
+                assert1(succ.at(i - 1).getPosition() <= succ.at(i).getPosition());
+            for (size_t i = 0; i < succ.items.size(); ++i)
+                assert1(succ.rankOf(succ.items[i].id) == i);
+        }},
+
+        {"parallel_build_matches_serial", [](){
+            int time = 0, serialTime = 0;
+            std::mt19937 gen(4242);
+            std::uniform_int_distribution<int> dis(-1000, 1000);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 70000; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), &time, i));
+
+            size_t threads = parallel::max_threads();
+            parallel::max_threads() = 1;
+            KineticSuccessor serialSucc(vec, &serialTime);
+            KineticHeap serialHeap(vec);
+            parallel::max_threads() = 4;
+            KineticSuccessor succ(vec, &time);
+            KineticHeap heap(vec);
+            parallel::max_threads() = threads;
+
+            for (size_t i = 0; i < succ.items.size(); ++i)
+                assert1(succ.items[i].id == serialSucc.items[i].id);
+            assert1(succ.certificates.vec.size() == serialSucc.certificates.vec.size());
+            for (size_t i = succ.certificates.root(); i < succ.certificates.vec.size(); ++i)
+                assert1(succ.certificates.vec[i].ref_index == serialSucc.certificates.vec[i].ref_index);
+            for (size_t i = 0; i < succ.ranks.size(); ++i)
+                assert1(succ.ranks[i] == serialSucc.ranks[i]);
+
+            for (size_t i = heap.root(); i < heap.nodes.size(); ++i)
+                assert1(heap.nodes[i].item.id == serialHeap.nodes[i].item.id && heap.nodes[i].event == serialHeap.nodes[i].event);
+            for (int step = 0; step < 5; ++step) {
+                heap.fastforward(1);
+                serialHeap.fastforward(1);
+                succ.fastforward(1);
+                serialSucc.fastforward(1);
+                assert1(*heap.min_handle() == *serialHeap.min_handle());
+                assert1(succ.items[0].id == serialSucc.items[0].id);
+            }
+        }},
+
+        {"kinetic_successor_bulk_matches_events", [](){
+            auto certificatesOf = [](const KineticSuccessor<int>& succ) {
+                std::vector<std::pair<size_t, double>> result;
+                for (size_t i = succ.certificates.root(); i < succ.certificates.vec.size(); ++i)
+                    result.push_back({succ.certificates.vec[i].ref_index, succ.certificates.vec[i].t});
+                std::sort(result.begin(), result.end());
+                return result;
+            };
+            for (int n : std::array<int, 2>{300, 50000}) {
+                int time = 0, bulkTime = 0;
+                std::mt19937 gen(n);
+                std::uniform_int_distribution<int> dis(-3 * n, 3 * n);
+                std::vector<MovingObject<int>> vec;
+                for (int i = 0; i < n; ++i)
+                    vec.push_back(MovingObject<int>(dis(gen), dis(gen) % 5, &time, i));
+
+                size_t threads = parallel::max_threads();
+                parallel::max_threads() = 3;
+                KineticSuccessor succ(vec, &time), bulk(vec, &bulkTime);
+                succ.rebuildFactor = std::numeric_limits<double>::infinity();
+                for (int step : std::array<int, 4>{1, 2, 5, 30}) {
+                    succ.fastforward(step);
+                    bulk.fastforwardBulk(step);
+                    for (int i = 0; i < n; ++i)
+                        assert1(bulk.items[i].id == succ.items[i].id && bulk.rankOf(i + 1) == succ.rankOf(i + 1));
+                    assert1(certificatesOf(bulk) == certificatesOf(succ));
+                }
+                assert1(bulk.rebuilds > 0);
+                parallel::max_threads() = threads;
+            }
+        }},
+
+        {"parallel_pool_runs_every_task", [](){
+            for (size_t threads : { 1, 2, 4 }) {
+                std::vector<std::atomic<int>> visits(1000);
+                std::atomic<int> nested(0);
+                std::mutex mutex;
+                std::set<std::thread::id> seen;
+                for (int call = 0; call < 3; ++call) {
+                    parallel::for_each_dynamic(visits.size(), threads, [&](size_t i) {
+                        visits[i]++;
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            seen.insert(std::this_thread::get_id());
+                        }
+                        // A call from inside a task runs on its thread
+                        if (i % 100 == 0)
+                            parallel::for_each_dynamic(10, 4, [&](size_t) { nested++; });
+                    });
+                }
+                for (std::atomic<int>& count : visits)
+                    assert1(count == 3);
+                assert1(nested == 3 * 10 * 10);
+                assert1(seen.size() <= threads);
+
+                // Every task waits for all the others, which only returns if they run at the same time
+                std::atomic<size_t> arrived(0);
+                parallel::for_each_dynamic(threads, threads, [&](size_t) {
+                    arrived++;
+                    while (arrived < threads)
+                        std::this_thread::yield();
+                });
+
+                // A task that throws, on the calling thread or another one, throws from the call once all are done
+                for (size_t thrower : { size_t(0), threads - 1 }) {
+                    std::atomic<size_t> finished(0);
+                    bool caught = false;
+                    try {
+                        parallel::pool().run(threads, [&](size_t task) {
+                            if (task == thrower)
+                                throw std::runtime_error("task");
+                            finished++;
+                        });
+                    } catch (const std::runtime_error&) {
+                        caught = true;
+                    }
+                    assert1(caught && finished == threads - 1);
+                }
+            }
+        }},
+
+        {"kinetic_shards_match_brute_force", [](){
+            // Once as is, and once with every shard step spread over several threads
+            for (size_t threads : { 0, 4 }) {
+                size_t defaultThreads = parallel::max_threads(), defaultGrain = parallel::grain();
+                if (threads > 0) {
+                    parallel::max_threads() = threads;
+                    parallel::grain() = 1;
+                }
+                std::mt19937 gen(777);
+                std::uniform_int_distribution<int> dis(-500, 500);
+                std::vector<std::vector<MovingObject<int>>> objects;
+                KineticShards<KineticHeap<int>> heaps;
+                KineticShards<KineticSuccessor<int>> successors;
+                for (int i = 0; i < 40; ++i) {
+                    // Every fourth shard never has events, since all its objects move together
+                    std::vector<MovingObject<int>> vec;
+                    int count = 1 + gen() % 60;
+                    for (int j = 0; j < count; ++j)
+                        vec.push_back(MovingObject<int>(dis(gen), i % 4 == 0 ? 3 : dis(gen) % 20, j));
+                    objects.push_back(vec);
+                    assert1(heaps.add_shard(vec) == static_cast<size_t>(i));
+                    assert1(successors.add_shard(vec) == static_cast<size_t>(i));
+                }
+
+                int time = 0;
+                for (int step : std::array<int, 6>{1, 1, 2, 5, 10, 100}) {
+                    time += step;
+                    heaps.fastforward(step);
+                    successors.fastforward(step);
+                    int lowest = std::numeric_limits<int>::max();
+                    for (size_t i = 0; i < objects.size(); ++i) {
+                        int shardLowest = std::numeric_limits<int>::max();
+                        for (const MovingObject<int>& object : objects[i])
+                            shardLowest = std::min(shardLowest, object.initialPosition + object.velocity * time);
+                        lowest = std::min(lowest, shardLowest);
+                        assert1(heaps.shard(i).min()->getPosition() == shardLowest);
+                        assert1(successors.shard(i).at(0).getPosition() == shardLowest);
+                    }
+                    assert1(heaps.min()->getPosition() == lowest);
+                    assert1(successors.min()->getPosition() == lowest);
+                }
+                assert1(heaps.shard_advances <= 6 * 30);
+                assert1(successors.shard_advances <= 6 * 30);
+                parallel::max_threads() = defaultThreads;
+                parallel::grain() = defaultGrain;
+            }
+        }},
+
+        {"kinetic_event_stepping", [](){
+            std::mt19937 gen(1357);
+            std::uniform_int_distribution<int> dis(-200, 200);
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 200; ++i)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen) % 13, i));
+            auto lowestAt = [&](double t) {
+                double lowest = std::numeric_limits<double>::infinity();
+                for (const MovingObject<int>& object : vec)
+                    lowest = std::min(lowest, object.initialPosition + object.velocity * t);
+                return lowest;
+            };
+
+            int time = 0;
+            KineticHeap<int> heap(vec);
+            KineticSuccessor<int> succ(vec, &time);
+            double previous = 0;
+            size_t steps = 0;
+            while (heap.next_event_time().value_or(100) < 100) {
+                double next = heap.advance_to_next_event().value();
+                assert1(next >= previous);
+                assert1(heap.time == static_cast<int>(std::floor(next)));
+                previous = next;
+                steps++;
+                // Between this event and the next one the min can't change
+                double after = (next + heap.next_event_time().value_or(next + 2)) / 2;
+                const Trajectory& min = heap.nodes[heap.root()].item;
+                assert1(min.intercept + min.slope * after == lowestAt(after));
+            }
+            assert1(steps > 0);
+            assert1(steps <= heap.events_processed);
+
+            previous = 0;
+            while (succ.nextEventTime().value_or(100) < 100) {
+                double next = succ.advanceToNextEvent().value();
+                assert1(next >= previous);
+                previous = next;
+                double after = (next + succ.nextEventTime().value_or(next + 2)) / 2;
+                for (size_t i = 1; i < succ.items.size(); ++i) {
+                    const Trajectory &a = succ.items[i - 1], &b = succ.items[i];
+                    assert1(a.intercept + a.slope * after <= b.intercept + b.slope * after);
+                }
+            }
+
+            // fastforward picks up from the last whole time
+            heap.fastforward(100 - heap.time);
+            succ.fastforward(100 - time);
+            assert1(heap.min()->getPosition() == lowestAt(100));
+            assert1(succ.at(0).getPosition() == lowestAt(100));
+        }},
+
+        {"kinetic_event_stepping_queries", [](){
+            // a overtakes b at 0.5, between whole times
+            int time = 0;
+            std::vector<MovingObject<int>> vec { MovingObject<int>(0, 2, &time, 1), MovingObject<int>(1, 0, &time, 2) };
+            KineticSuccessor<int> succ(vec, &time);
+            assert1(succ.advanceToNextEvent() == 0.5);
+            assert1(time == 0);
+            // The queries are as of the event, where both are at 1 and b has just got in front
+            assert1(succ.range(0, 0)->empty());
+            assert1(succ.range(1, 1)->size() == 2);
+            assert1(succ.lowerBound(1) == 0 && succ.upperBound(1) == 2);
+            assert1(succ.findLocation(vec[0]) == 1 && succ.findLocation(vec[1]) == 0);
+            assert1(succ.findPredecessor(vec[0])->value == 2);
+            assert1(succ.findSuccessor(vec[1])->value == 1);
+            assert1(!succ.findSuccessor(vec[0]));
+            assert1(!succ.findPredecessor(vec[1]));
+            // Standing still keeps to the event, and moving past it goes back to the time
+            succ.fastforward(0);
+            assert1(succ.findLocation(vec[0]) == 1);
+            succ.fastforward(1);
+            assert1(succ.range(0, 1)->size() == 1 && (*succ.range(0, 1))[0].id == 2);
+            assert1(succ.findSuccessor(vec[1])->value == 1);
+
+            // Events at times like 2/3 or 2/19 aren't doubles, and the objects meeting there still tie
+            for (auto [slow, fast] : { std::make_pair(2, 3), std::make_pair(2, 19) }) {
+                time = 0;
+                std::vector<MovingObject<int>> crossing {
+                    MovingObject<int>(5, fast + 1, &time, 1), MovingObject<int>(5 + slow, 1, &time, 2), MovingObject<int>(-1, 0, &time, 3)
+                };
+                KineticSuccessor<int> crossed(crossing, &time);
+                crossed.advanceToNextEvent();
+                assert1(*crossed.eventTime == (CoordinateTraits<int>::Failure { slow, static_cast<uint32_t>(fast) }));
+                assert1(crossed.findLocation(crossing[0]) == 2 && crossed.findLocation(crossing[1]) == 1);
+                assert1(crossed.findLocation(crossing[2]) == 0);
+                assert1(crossed.findSuccessor(crossing[1])->value == 1);
+                assert1(crossed.findPredecessor(crossing[0])->value == 2);
+                assert1(crossed.lowerBound(5) == 1 && crossed.upperBound(10) == 3);
+            }
+
+            // Changes to a heap right after an event keep to its order then: c is lowest at 0.5,
+            // although a is at 0
+            KineticHeap<int> heap(std::vector<MovingObject<int>>{ MovingObject<int>(0, 4, 1), MovingObject<int>(2, 0, 2) });
+            assert1(heap.advance_to_next_event() == 0.5);
+            assert1(heap.min()->value == 2);
+            size_t c = heap.insert(MovingObject<int>(1, 0, 3));
+            assert1(*heap.min_handle() == c);
+            size_t d = heap.insert(MovingObject<int>(-1, 6, 4));
+            assert1(*heap.min_handle() == c);
+            heap.erase(c);
+            assert1(heap.min()->value == 2);
+            heap.fastforward(1);
+            assert1(heap.min()->value == 2 && heap.min()->getPosition() == 2);
+            heap.fastforward(-1);
+            assert1(heap.min()->value == 4 && heap.min()->getPosition() == -1);
+            heap.erase(d);
+            assert1(heap.min()->value == 1);
+        }},
+
+        {"kinetic_successor_tree_dynamic", [](){
+            std::mt19937 gen(2468);
+            std::uniform_int_distribution<int> dis(-30, 30);
+            int time = 0;
+            KineticSuccessorTree<int> tree(std::vector<MovingObject<int>>{
+                MovingObject<int>(0, 1, &time, 0),
+                MovingObject<int>(5, -1, &time, 1),
+            }, &time);
+            std::map<size_t, int> live {{1, 0}, {2, 1}};
+            int nextValue = 2;
+
+            for (int step = 0; step < 1500; step++) {
+                int op = gen() % 3;
+                if (op == 0 || live.size() < 2) {
+                    int value = nextValue++;
+                    live[tree.insert(MovingObject<int>(dis(gen), dis(gen), &time, value))] = value;
+                } else if (op == 1) {
+                    auto it = std::next(live.begin(), gen() % live.size());
+                    tree.erase(it->first);
+                    live.erase(it);
+                } else {
+                    tree.fastforward(gen() % 3);
+                }
+
+                std::vector<Trajectory> expected;
+                for (auto [handle, value] : live) {
+                    assert1(tree.get(handle).value == value);
+                    expected.push_back(tree.get(handle).trajectory(handle));
+                }
+                std::sort(expected.begin(), expected.end(), [&](auto &a, auto &b) { return tree.before(a, b); });
+
+                assert1(tree.size() == live.size());
+                std::optional<size_t> cur = tree.first();
+                for (size_t i = 0; i < expected.size(); i++) {
+                    assert1(cur.value() == expected[i].id);
+                    std::optional<size_t> next = tree.findSuccessor(cur.value());
+                    if (next.has_value())
+                        assert1(tree.findPredecessor(next.value()) == cur);
+                    cur = next;
+                }
+                assert1(!cur.has_value());
+            }
+        }},
+
+        {"kinetic_successor_handles", [](){
+            std::mt19937 gen(1357);
+            std::uniform_int_distribution<int> dis(-1000, 1000);
+            int time = 0;
+            std::vector<MovingObject<int>> vec;
+            for (int i = 0; i < 1000; i++)
+                vec.push_back(MovingObject<int>(dis(gen), dis(gen), &time, i));
+            KineticSuccessor succ(vec, &time);
+
+            for (int step : std::array<int, 3>{1, 5, 20}) {
+                succ.fastforward(step);
+                for (size_t handle = 1; handle <= vec.size(); handle++) {
+                    assert1(succ.get(handle).value == vec[handle - 1].value);
+                    size_t rank = succ.rankOf(handle);
+                    assert1(succ.findLocation(vec[handle - 1]) == static_cast<int>(rank));
+                    std::optional<size_t> next = succ.findSuccessor(handle);
+                    assert1(next.has_value() == (rank + 1 < vec.size()));
+                    if (next.has_value()) {
+                        assert1(succ.rankOf(next.value()) == rank + 1);
+                        assert1(succ.findSuccessor(vec[handle - 1]).value() == succ.get(next.value()));
+                    }
+                }
+            }
+            assert1(succ.findLocation(MovingObject<int>(0, 0, &time, -1)) == -1);
+        }},
+
         {"kinetic_successor_random", [](){
             std::mt19937 t(818239390);
             std::uniform_int_distribution<int> dis(-20000, 20000);
@@ -194,8 +1251,8 @@ namespace test {
             }
             std::cout << std::endl;*/
             for (int i = 0; i < vec.size(); i++) {
-                //std::cout << vec[i].getPosition() << ' ' << succ.items[i].getPosition() << std::endl;
-                if (vec[i].value != succ.items[i].value) {
+                //std::cout << vec[i].getPosition() << ' ' << succ.at(i).getPosition() << std::endl;
+                if (vec[i].value != succ.at(i).value) {
                     assert1(false);
                 }
             }
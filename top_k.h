@@ -0,0 +1,184 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include "heap.h"
+
+// The k lowest objects in order, kept kinetically. The top k sit sorted in a small array with a
+// certificate for every adjacent pair, and a boundary certificate compares the last of them with the
+// min of a kinetic heap holding everything else. A swap inside the top k costs O(log k), independent
+// of the number of objects, and only events at the root of the heap reach the top k.
+// CertificateArity is the arity of both event queues, and Coord the coordinate type, like in KineticHeap.
+template<typename T, size_t CertificateArity = 4, typename Coord = int>
+struct KineticTopK {
+    using Rest = KineticHeap<size_t, CertificateArity, Coord>;
+    using Traits = CoordinateTraits<Coord>;
+    using Failure = typename Traits::Failure;
+    using Item = BasicTrajectory<Coord>;
+
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+    // The lowest min(k, size()) objects in order. Each item's id is its handle.
+    std::vector<Item> top;
+    // Everything else, with the handle as the value. Its own handles are unrelated to ours.
+    Rest rest;
+    // Index in top of each handle, or none if it's in rest
+    std::vector<size_t> rank_of;
+    // Handle in rest of each handle, or 0 if it's in top
+    std::vector<size_t> rest_handle_of;
+    // Payload of each handle. Handles start at 1, so 0 can mean "none".
+    std::vector<T> values;
+    // Slot i (1 <= i < top.size()) certifies that top[i - 1] comes before top[i], and slot top.size()
+    // that top.back() comes before the min of rest.
+    MinHeap<Failure, size_t, false, RefTable, std::less<Failure>, CertificateArity> certificates;
+    RefTable certificate_slots;
+    Coord time;
+
+    // Number of certificate failures processed in top and at the boundary, over the structure's lifetime.
+    // The events of rest are counted by rest.
+    size_t events_processed = 0;
+
+    // The item at index i of items_ gets handle i + 1.
+    KineticTopK(const std::vector<MovingObject<T, Coord> >& items_, size_t k)
+        : rest(std::vector<MovingObject<size_t, Coord> >()), rank_of(items_.size() + 1, none),
+          rest_handle_of(items_.size() + 1, 0), values(items_.size() + 1), certificates(&certificate_slots), time(0) {
+        std::vector<Item> all;
+        all.reserve(items_.size());
+        for (size_t i = 0; i < items_.size(); ++i) {
+            all.push_back(items_[i].trajectory(i + 1));
+            values[i + 1] = items_[i].value;
+        }
+
+        // Selecting the top k is O(n), and only they get sorted
+        size_t m = std::min(k, all.size());
+        std::nth_element(all.begin(), all.begin() + m, all.end(), BasicPositionAt<Coord> { time });
+        std::sort(all.begin(), all.begin() + m, BasicPositionAt<Coord> { time });
+        top.assign(all.begin(), all.begin() + m);
+        for (size_t i = 0; i < m; ++i)
+            rank_of[top[i].id] = i;
+
+        // rest is built in place, since its event queue points into it. Handle i of rest is the object at all[m + i - 1].
+        std::vector<Item> others(all.begin() + m, all.end());
+        rest.node_of.assign(others.size() + 1, 0);
+        rest.values.assign(others.size() + 1, 0);
+        for (size_t i = 0; i < others.size(); ++i) {
+            rest.values[i + 1] = others[i].id;
+            rest_handle_of[others[i].id] = i + 1;
+            others[i].id = static_cast<uint32_t>(i + 1);
+        }
+        rest.build(others);
+
+        certificate_slots.index.assign(m + 1, 0);
+        for (size_t slot = 1; has_slot(slot); ++slot)
+            set_certificate(slot, Traits::whole(time));
+    }
+
+    size_t size() const {
+        return top.size() + rest.size();
+    }
+
+    // The lowest k objects in order, or every object if there are fewer. Each item's id is its handle,
+    // and position(time) is where it is. No copy is made.
+    Span<Item> top_k() const {
+        return Span<Item> { top.data(), top.size() };
+    }
+
+    // Gets the object with the given handle
+    MovingObject<T, Coord> get(size_t handle) {
+        const Item& item = rank_of[handle] != none ? top[rank_of[handle]] : rest.nodes[rest.node_of[rest_handle_of[handle]]].item;
+        return MovingObject<T, Coord>(item, &time, values[handle]);
+    }
+
+    std::optional<MovingObject<T, Coord> > min() {
+        if (top.empty())
+            return std::nullopt;
+        return MovingObject<T, Coord>(top[0], &time, values[top[0].id]);
+    }
+
+    // Whether slot exists: a pair in top, or the boundary if rest isn't empty
+    bool has_slot(size_t slot) const {
+        return slot >= 1 && (slot < top.size() || (slot == top.size() && rest.size() > 0));
+    }
+
+    // Recomputes the certificate of slot as of time now, updating it in place if it exists.
+    // No certificate is kept if the pair is moving apart.
+    void set_certificate(size_t slot, const Failure& now) {
+        const Item& above = top[slot - 1];
+        const Item& below = slot < top.size() ? top[slot] : rest.nodes[rest.root()].item;
+        size_t index = certificate_slots.index[slot];
+        if (above.slope > below.slope) {
+            Failure failure = Traits::failure(above, below);
+            if (failure >= now) {
+                if (index != 0)
+                    certificates.update(index, failure);
+                else
+                    certificates.add(failure, slot);
+                return;
+            }
+        }
+        certificates.remove(index);
+    }
+
+    // Processes the certificate of top that fails first: the pair swaps, or at the boundary,
+    // the min of rest takes the place of top.back() and that goes to the root of rest.
+    void process_event() {
+        ++events_processed;
+        Failure now = certificates.min().value();
+        size_t slot = certificates.min_ref_index().value();
+        certificates.remove_min();
+
+        if (slot < top.size()) {
+            std::swap(top[slot - 1], top[slot]);
+            rank_of[top[slot - 1].id] = slot - 1;
+            rank_of[top[slot].id] = slot;
+        } else {
+            // The two trade places, so the root of rest keeps its handle there and only changes payload
+            Item& root = rest.nodes[rest.root()].item;
+            Item& last = top.back();
+            size_t rest_handle = root.id;
+            size_t rising = rest.values[rest_handle];
+            rest.values[rest_handle] = last.id;
+            rest_handle_of[last.id] = rest_handle;
+            rank_of[last.id] = none;
+            rest_handle_of[rising] = 0;
+            rank_of[rising] = slot - 1;
+            std::swap(root.intercept, last.intercept);
+            std::swap(root.slope, last.slope);
+            last.id = static_cast<uint32_t>(rising);
+
+            for (size_t child : { Rest::left(rest.root()), Rest::right(rest.root()) })
+                if (child < rest.nodes.size())
+                    rest.set_certificate(child, now);
+        }
+
+        for (size_t j : { slot - 1, slot, slot + 1 })
+            if (has_slot(j))
+                set_certificate(j, now);
+    }
+
+    // Moves timeToForward ahead, which must not be negative. Events of top and rest are processed
+    // in order, and an event of rest only touches the boundary when it changes the min of rest.
+    void fastforward(Coord timeToForward) {
+        time += timeToForward;
+        Failure horizon = Traits::whole(time);
+        for (;;) {
+            bool top_due = !certificates.empty() && *certificates.min() < horizon;
+            bool rest_due = rest.fails_before(horizon);
+            if (!top_due && !rest_due)
+                break;
+            if (top_due && (!rest_due || !(*rest.events.min() < *certificates.min()))) {
+                process_event();
+                continue;
+            }
+
+            Failure now = *rest.events.min();
+            bool at_root = Rest::parent(*rest.events.min_ref_index()) == rest.root();
+            rest.process_event();
+            if (at_root && has_slot(top.size()))
+                set_certificate(top.size(), now);
+        }
+        rest.time = time;
+    }
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <ostream>
+#include <limits>
+#include "min_heap.h"
+#include "trajectory.h"
+#include "trajectory_store.h"
+
+// A kinetic tournament: an implicit complete binary tree over the objects, where every internal
+// node holds the winner (the lowest object) of its two children and one certificate, that its
+// winner stays ahead of the loser. An event only changes winners along one leaf-to-root path,
+// so each event costs O(log n) and there are O(n log n) events in total.
+// CertificateArity is the arity of the event queue, like in KineticHeap.
+template<typename T, size_t CertificateArity = 4>
+struct KineticTournament {
+    // Trajectory and payload of each handle. Handles start at 1, so 0 can mean "none".
+    std::vector<Trajectory> items;
+    std::vector<T> values;
+    // Number of leaves, a power of two. Leaf k is node leaves + k and holds handle k + 1, or 0 as padding.
+    size_t leaves;
+    // Handle of the winner of each node. winners[1] is the root, and winners[0] is unused.
+    std::vector<uint32_t> winners;
+    // Certificate failure times keyed by internal node
+    MinHeap<double, size_t, false, RefTable, std::less<double>, CertificateArity> events;
+    RefTable event_slots;
+    int time;
+
+    // Number of certificate failures processed over the tournament's lifetime
+    size_t events_processed = 0;
+
+    // The item at index i of items_ gets handle i + 1.
+    KineticTournament(const std::vector<MovingObject<T> >& items_)
+        : items(items_.size() + 1), values(items_.size() + 1), leaves(1), events(&event_slots), time(0) {
+        while (leaves < items_.size())
+            leaves *= 2;
+        winners.assign(2 * leaves, 0);
+        event_slots.index.assign(2 * leaves, 0);
+        for (size_t i = 0; i < items_.size(); ++i) {
+            items[i + 1] = items_[i].trajectory(i + 1);
+            values[i + 1] = items_[i].value;
+            winners[leaves + i] = i + 1;
+        }
+        build();
+    }
+
+    size_t size() const {
+        return items.size() - 1;
+    }
+
+    // Whether a is ahead of b at time t, with ties going to the object that will be ahead just after t.
+    // This is PositionAt for fractional times.
+    static bool ahead(const Trajectory& a, const Trajectory& b, double t) {
+        double positionA = a.intercept + static_cast<double>(a.slope) * t;
+        double positionB = b.intercept + static_cast<double>(b.slope) * t;
+        if (positionA != positionB)
+            return positionA < positionB;
+        if (a.slope != b.slope)
+            return a.slope < b.slope;
+        return a.id < b.id;
+    }
+
+    // Winner among two handles at time t, where 0 loses to everything
+    uint32_t play(uint32_t a, uint32_t b, double t) const {
+        if (a == 0 || b == 0)
+            return a | b;
+        return ahead(items[a], items[b], t) ? a : b;
+    }
+
+    // Handle of the winner of the child of internal node i that didn't win, or 0 if there's none
+    uint32_t loser(size_t i) const {
+        return winners[2 * i] == winners[i] ? winners[2 * i + 1] : winners[2 * i];
+    }
+
+    // Plays every match at the current time and computes all certificates from scratch, in O(n)
+    void build() {
+        events.clear();
+        for (size_t i = leaves - 1; i >= 1; --i) {
+            uint32_t a = winners[2 * i], b = winners[2 * i + 1];
+            winners[i] = (a == 0 || b == 0) ? (a | b) : (PositionAt { time }(items[a], items[b]) ? a : b);
+        }
+
+        // Line every winner up with its loser so all the certificates come out of one kernel call
+        std::vector<size_t> matches;
+        TrajectoryStore winning, losing;
+        for (size_t i = 1; i < leaves; ++i) {
+            if (loser(i) != 0) {
+                matches.push_back(i);
+                winning.push_back(items[winners[i]]);
+                losing.push_back(items[loser(i)]);
+            }
+        }
+        std::vector<double> failures(matches.size());
+        simd::failure_times(winning.intercepts.data(), winning.slopes.data(),
+                            losing.intercepts.data(), losing.slopes.data(), matches.size(), failures.data());
+        for (size_t k = 0; k < matches.size(); ++k) {
+            if (failures[k] >= time)
+                events.vec.push_back({ failures[k], matches[k] });
+        }
+        events.heapify();
+        events.relink();
+    }
+
+    // Recomputes the certificate of internal node i as of time now, updating it in place if it exists.
+    // No certificate is kept if the loser never catches up.
+    void set_certificate(size_t i, double now) {
+        uint32_t other = loser(i);
+        double failure = other != 0 ? failureTime(items[winners[i]], items[other]) : -std::numeric_limits<double>::infinity();
+        size_t index = event_slots.index[i];
+        if (failure >= now) {
+            if (index != 0)
+                events.update(index, failure);
+            else
+                events.add(failure, i);
+        } else {
+            events.remove(index);
+        }
+    }
+
+    // Gets the object with the given handle
+    MovingObject<T> get(size_t handle) {
+        return MovingObject<T>(items[handle], &time, values[handle]);
+    }
+
+    std::optional<size_t> min_handle() const {
+        return winners[1] != 0 ? std::make_optional<size_t>(winners[1]) : std::nullopt;
+    }
+
+    std::optional<MovingObject<T>> min() {
+        if (winners[1] == 0)
+            return std::nullopt;
+        return get(winners[1]);
+    }
+
+    void fastforward(int timeToForward) {
+        time += timeToForward;
+
+        while (events.min().value_or(std::numeric_limits<double>::infinity()) < time) {
+            ++events_processed;
+            double time = events.min().value();
+            size_t node = events.min_ref_index().value();
+
+            // The loser overtakes the winner, which can then never catch up again.
+            events.remove_min();
+            winners[node] = loser(node);
+            set_certificate(node, time);
+
+            // Replay the matches above until one keeps its winner. Its loser may have changed, though.
+            while (node > 1) {
+                node /= 2;
+                uint32_t previous = winners[node];
+                winners[node] = play(winners[2 * node], winners[2 * node + 1], time);
+                set_certificate(node, time);
+                if (winners[node] == previous)
+                    break;
+            }
+        }
+    }
+};
+
+template<typename T, size_t CertificateArity>
+std::ostream& operator<<(std::ostream& out, const KineticTournament<T, CertificateArity>& tournament) {
+    out << "Winners: ";
+    for (size_t i = 1; i < tournament.winners.size(); ++i)
+        out << tournament.winners[i] << ", ";
+    out << "\nCert: ";
+    for (size_t i = tournament.events.root(); i < tournament.events.vec.size(); ++i)
+        out << "(" << tournament.events.vec[i].t << ", " << tournament.events.ref_index(i) << "), ";
+    out << "\n";
+    return out;
+}
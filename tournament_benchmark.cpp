@@ -0,0 +1,60 @@
+// The purpose of this file is to compare the kinetic tournament against the kinetic heap as a kinetic min engine.
+
+#include "heap.h"
+#include "tournament.h"
+#include <vector>
+#include <array>
+#include <iostream>
+#include <time.h>
+#include <experimental/random>
+
+using namespace std;
+
+// Runs both structures over the same objects and time increments, checking that they agree on the min
+void run(int num_particle) {
+    std::vector<MovingObject<int>> moving_objs;
+    for (int k = 0; k < num_particle; k++) {
+        moving_objs.push_back(MovingObject<int>(std::experimental::randint(-5000, 5000),
+                                                std::experimental::randint(-1000, 1000),
+                                                std::experimental::randint(0, 100)));
+    }
+    std::cout << num_particle << " objects" << std::endl;
+
+    clock_t build_start = clock();
+    KineticHeap<int> kinetic_heap(moving_objs);
+    clock_t build_mid = clock();
+    KineticTournament<int> tournament(moving_objs);
+    clock_t build_end = clock();
+    kinetic_heap.rebuild_factor = std::numeric_limits<double>::infinity();
+    std::cout << "  [Kinetic heap] build time: " << (build_mid - build_start) * 1.0 / CLOCKS_PER_SEC * 1000 << "ms" << std::endl;
+    std::cout << "  [Kinetic tournament] build time: " << (build_end - build_mid) * 1.0 / CLOCKS_PER_SEC * 1000 << "ms" << std::endl;
+
+    std::array<int, 6> time_incs {1, 10, 100, 500, 1000, 10000};
+    double heap_time_sum = 0;
+    double tournament_time_sum = 0;
+    for (int j = 0; j < time_incs.size(); j++) {
+        clock_t heap_start = clock();
+        kinetic_heap.fastforward(time_incs[j]);
+        int heap_min = kinetic_heap.min().value().getPosition();
+        clock_t heap_end = clock();
+        heap_time_sum += (heap_end - heap_start) * 1.0 / CLOCKS_PER_SEC * 1000;
+
+        clock_t tournament_start = clock();
+        tournament.fastforward(time_incs[j]);
+        int tournament_min = tournament.min().value().getPosition();
+        clock_t tournament_end = clock();
+        tournament_time_sum += (tournament_end - tournament_start) * 1.0 / CLOCKS_PER_SEC * 1000;
+
+        std::cout << "  " << j << " [Kinetic heap]min: " << heap_min << " time: " << (heap_end - heap_start) * 1.0 / CLOCKS_PER_SEC * 1000 << "ms" << std::endl;
+        std::cout << "  " << j << " [Kinetic tournament]min: " << tournament_min << " time: " << (tournament_end - tournament_start) * 1.0 / CLOCKS_PER_SEC * 1000 << "ms" << std::endl;
+        if (heap_min != tournament_min)
+            std::cout << "  MISMATCH" << std::endl;
+    }
+    std::cout << "  Kinetic heap total time: " << heap_time_sum << "ms, events processed: " << kinetic_heap.events_processed << std::endl;
+    std::cout << "  Kinetic tournament total time: " << tournament_time_sum << "ms, events processed: " << tournament.events_processed << std::endl;
+}
+
+int main(int argc, char** argv) {
+    for (int num_particle : {50000, 1000000})
+        run(num_particle);
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <limits>
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
+
+// An affine trajectory intercept + slope * t, tagged with the index of its payload.
+// This is what the kinetic structures store internally: with int coordinates it's 12 bytes,
+// has no pointer to chase for the time, and compares on plain fields.
+template<typename Coord>
+struct BasicTrajectory {
+    Coord intercept;
+    Coord slope;
+    uint32_t id;
+
+    Coord position(Coord t) const {
+        return intercept + slope * t;
+    }
+
+    // Time at which the two trajectories meet, or -infinity if they're parallel
+    double intersectionTime(const BasicTrajectory &other) const {
+        if (slope == other.slope)
+            return -std::numeric_limits<double>::infinity();
+        return (other.intercept - intercept * 1.0) / (slope - other.slope);
+    }
+};
+
+using Trajectory = BasicTrajectory<int>;
+
+// A read-only view of contiguous elements, such as part of a kinetic structure's order.
+// It stays valid until the structure changes.
+template<typename T>
+struct Span {
+    const T *first;
+    size_t count;
+
+    const T *begin() const {
+        return first;
+    }
+
+    const T *end() const {
+        return first + count;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    const T &operator[](size_t i) const {
+        return first[i];
+    }
+};
+
+// Failure time of the certificate that a stays at or before b, or -infinity if that
+// never fails because b is at least as fast as a. Same as simd::failure_times.
+template<typename Coord>
+double failureTime(const BasicTrajectory<Coord> &a, const BasicTrajectory<Coord> &b) {
+    return a.slope > b.slope ? a.intersectionTime(b) : -std::numeric_limits<double>::infinity();
+}
+
+// Orders trajectories by position at a fixed time, and then by slope so that
+// the trajectory that will be smaller just after that time comes first.
+// Time can be fractional, for orders between integer times.
+template<typename Time>
+struct BasicPositionAt {
+    Time time;
+
+    template<typename Coord>
+    bool operator()(const BasicTrajectory<Coord> &a, const BasicTrajectory<Coord> &b) const {
+        auto positionA = a.intercept + a.slope * time;
+        auto positionB = b.intercept + b.slope * time;
+        if (positionA != positionB)
+            return positionA < positionB;
+        if (a.slope != b.slope)
+            return a.slope < b.slope;
+        return a.id < b.id;
+    }
+};
+
+using PositionAt = BasicPositionAt<int>;
+
+// The exact time num / den (with den > 0) at which two trajectories with integer coordinates meet.
+// Comparisons cross-multiply instead of dividing, so two crossings only compare equal when they really
+// are simultaneous, and never in the wrong order. num and den are differences of coordinates, so
+// 64-bit coordinates must stay within +-2^62 for them to fit. Den is uint32_t for 32-bit coordinates,
+// which with 4-byte packing makes a 12-byte time that fits an event queue element in 16 bytes.
+#pragma pack(push, 4)
+template<typename Den>
+struct BasicCrossingTime {
+#ifdef __SIZEOF_INT128__
+    using Wide = __int128;
+#else
+    using Wide = long double;
+#endif
+
+    int64_t num;
+    Den den;
+
+    // Denominator of the times that come from double arithmetic, in approximate mode
+    static constexpr Den resolution = Den(1) << 20;
+
+    // The first multiple of 1 / resolution at or after t, which is t itself for whole times
+    static BasicCrossingTime at(double t) {
+        return { static_cast<int64_t>(std::ceil(t * resolution)), resolution };
+    }
+
+    explicit operator double() const {
+        return static_cast<double>(num) / den;
+    }
+
+    // Largest whole time not after this one
+    int64_t floor() const {
+        int64_t d = den;
+        return num >= 0 ? num / d : -((-num + d - 1) / d);
+    }
+};
+#pragma pack(pop)
+
+template<typename Den>
+bool operator<(const BasicCrossingTime<Den> &a, const BasicCrossingTime<Den> &b) {
+    using Wide = typename BasicCrossingTime<Den>::Wide;
+    return static_cast<Wide>(a.num) * b.den < static_cast<Wide>(b.num) * a.den;
+}
+
+template<typename Den>
+bool operator==(const BasicCrossingTime<Den> &a, const BasicCrossingTime<Den> &b) {
+    using Wide = typename BasicCrossingTime<Den>::Wide;
+    return static_cast<Wide>(a.num) * b.den == static_cast<Wide>(b.num) * a.den;
+}
+
+template<typename Den>
+bool operator!=(const BasicCrossingTime<Den> &a, const BasicCrossingTime<Den> &b) {
+    return !(a == b);
+}
+
+template<typename Den>
+bool operator>(const BasicCrossingTime<Den> &a, const BasicCrossingTime<Den> &b) {
+    return b < a;
+}
+
+template<typename Den>
+bool operator<=(const BasicCrossingTime<Den> &a, const BasicCrossingTime<Den> &b) {
+    return !(b < a);
+}
+
+template<typename Den>
+bool operator>=(const BasicCrossingTime<Den> &a, const BasicCrossingTime<Den> &b) {
+    return !(a < b);
+}
+
+// Arithmetic of the kinetic structures for a coordinate type, which is also the type of time.
+// Failure is the type of certificate failure times.
+template<typename Coord, typename = void>
+struct CoordinateTraits;
+
+// Integer coordinates get exact crossing times
+template<typename Coord>
+struct CoordinateTraits<Coord, std::enable_if_t<std::is_integral_v<Coord> > > {
+    // The difference of two slopes fits an unsigned type of the same size
+    using Failure = BasicCrossingTime<std::conditional_t<sizeof(Coord) <= 4, uint32_t, int64_t> >;
+    using Den = decltype(Failure::den);
+    using Wide = typename Failure::Wide;
+
+    // Time at which a gets caught up by b, assuming a.slope > b.slope
+    static Failure failure(const BasicTrajectory<Coord> &a, const BasicTrajectory<Coord> &b) {
+        return { static_cast<int64_t>(b.intercept) - a.intercept, static_cast<Den>(static_cast<int64_t>(a.slope) - b.slope) };
+    }
+
+    static Failure whole(Coord t) {
+        return { static_cast<int64_t>(t), 1 };
+    }
+
+    // Failure time for a time computed in double arithmetic
+    static Failure at(double t) {
+        return Failure::at(t);
+    }
+
+    static double to_double(const Failure &failure) {
+        return static_cast<double>(failure);
+    }
+
+    // Position of a at time t, scaled by t's denominator so that positions at the same time compare exactly
+    static Wide scaled_position(const BasicTrajectory<Coord> &a, const Failure &t) {
+        return static_cast<Wide>(a.intercept) * t.den + static_cast<Wide>(a.slope) * t.num;
+    }
+
+    // A fixed position scaled the same way, to compare with scaled_position
+    static Wide scaled(Coord position, const Failure &t) {
+        return static_cast<Wide>(position) * t.den;
+    }
+
+    // Latest time the clock can be at without going past failure
+    static Coord clock(const Failure &failure) {
+        return static_cast<Coord>(failure.floor());
+    }
+};
+
+// Floating-point coordinates get failure times of the same type, so that the clock can stop right at them.
+template<typename Coord>
+struct CoordinateTraits<Coord, std::enable_if_t<std::is_floating_point_v<Coord> > > {
+    using Failure = Coord;
+    using Wide = Coord;
+
+    static Failure failure(const BasicTrajectory<Coord> &a, const BasicTrajectory<Coord> &b) {
+        return (b.intercept - a.intercept) / (a.slope - b.slope);
+    }
+
+    static Failure whole(Coord t) {
+        return t;
+    }
+
+    static Failure at(double t) {
+        return static_cast<Coord>(t);
+    }
+
+    static double to_double(const Failure &failure) {
+        return failure;
+    }
+
+    static Wide scaled_position(const BasicTrajectory<Coord> &a, const Failure &t) {
+        return a.intercept + a.slope * t;
+    }
+
+    static Wide scaled(Coord position, const Failure &) {
+        return position;
+    }
+
+    static Coord clock(const Failure &failure) {
+        return failure;
+    }
+};
+
+// Same order as BasicPositionAt at a failure time, with positions compared exactly even when the
+// time isn't a whole one, so that objects meeting right at it tie
+template<typename Coord>
+struct ExactPositionAt {
+    using Traits = CoordinateTraits<Coord>;
+
+    typename Traits::Failure time;
+
+    bool operator()(const BasicTrajectory<Coord> &a, const BasicTrajectory<Coord> &b) const {
+        auto positionA = Traits::scaled_position(a, time);
+        auto positionB = Traits::scaled_position(b, time);
+        if (positionA != positionB)
+            return positionA < positionB;
+        if (a.slope != b.slope)
+            return a.slope < b.slope;
+        return a.id < b.id;
+    }
+};
+
+// Coord is the type of positions, velocities and time.
+template<typename T, typename Coord = int>
+struct MovingObject {
+    Coord initialPosition;
+    Coord velocity;
+    Coord *curtime;
+    T value;
+
+    // Constructor used as the default constructor for the kinetic heap
+    MovingObject() {}
+
+    // Constructor used for kinetic heap, since
+    // `curtime` is assigned at construction there
+    MovingObject(Coord ip, Coord v, T val) : initialPosition(ip), velocity(v), curtime(nullptr), value(val) {}
+
+    MovingObject(Coord ip, Coord v, Coord *t, T val) : initialPosition(ip), velocity(v), curtime(t), value(val) {}
+
+    // Constructor used to hand objects stored as trajectories back to the user
+    MovingObject(const BasicTrajectory<Coord> &trajectory, Coord *t, T val)
+        : initialPosition(trajectory.intercept), velocity(trajectory.slope), curtime(t), value(val) {}
+
+    // The compact form that the kinetic structures store, with id indexing wherever they keep the value
+    BasicTrajectory<Coord> trajectory(uint32_t id) const {
+        return BasicTrajectory<Coord> { initialPosition, velocity, id };
+    }
+
+    double getIntersectionTime(const MovingObject &other) const {
+        // Avoid returning NaN when both numerator and denominator are 0
+        if (velocity - other.velocity == 0)
+            return -std::numeric_limits<double>::infinity();
+        return (other.initialPosition - initialPosition * 1.0) / (velocity - other.velocity);
+    }
+
+    Coord getPosition() const {
+        return initialPosition + velocity * (*curtime);
+    }
+
+    bool operator<(const MovingObject &other) const {
+        if (getPosition() == other.getPosition()) {
+            return value < other.value;
+        }
+        return getPosition() < other.getPosition();
+    }
+
+    bool operator==(const MovingObject &other) const {
+        return initialPosition == other.initialPosition && velocity == other.velocity && value == other.value;
+    }
+
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "trajectory.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KINETIC_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Vectorized kernels over trajectories stored as separate intercept and slope arrays.
+// Every kernel has a scalar version, and the AVX2 or SSE4.1 version is picked at runtime
+// when the CPU supports it. All versions return bit-identical results: positions wrap around
+// on overflow in every version, like the 32-bit lanes do.
+namespace simd {
+    namespace scalar {
+        // intercept + slope * t modulo 2^32, which unlike int arithmetic is defined on overflow
+        inline int wrapped_position(int intercept, int slope, int t) {
+            return static_cast<int>(static_cast<uint32_t>(intercept) + static_cast<uint32_t>(slope) * static_cast<uint32_t>(t));
+        }
+
+        // out[i] = intercept[i] + slope[i] * t
+        inline void positions_at(const int* intercept, const int* slope, size_t n, int t, int* out) {
+            for (size_t i = 0; i < n; ++i)
+                out[i] = wrapped_position(intercept[i], slope[i], t);
+        }
+
+        // Smallest intercept[i] + slope[i] * t, or INT_MAX if n is 0
+        inline int min_position_at(const int* intercept, const int* slope, size_t n, int t) {
+            int best = std::numeric_limits<int>::max();
+            for (size_t i = 0; i < n; ++i)
+                best = std::min(best, wrapped_position(intercept[i], slope[i], t));
+            return best;
+        }
+
+        // Time at which a[i] (currently in front) gets overtaken by b[i], or -infinity if that never happens
+        // because b is at least as fast. This is the failure time of the certificate a[i] <= b[i].
+        inline void failure_times(const int* interceptA, const int* slopeA, const int* interceptB, const int* slopeB,
+                                  size_t n, double* out) {
+            for (size_t i = 0; i < n; ++i) {
+                double denominator = static_cast<double>(slopeA[i]) - slopeB[i];
+                out[i] = denominator > 0
+                    ? (static_cast<double>(interceptB[i]) - interceptA[i]) / denominator
+                    : -std::numeric_limits<double>::infinity();
+            }
+        }
+    }
+
+#ifdef KINETIC_X86_KERNELS
+    namespace avx2 {
+        __attribute__((target("avx2")))
+        inline void positions_at(const int* intercept, const int* slope, size_t n, int t, int* out) {
+            __m256i time = _mm256_set1_epi32(t);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(intercept + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slope + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi32(a, _mm256_mullo_epi32(b, time)));
+            }
+            scalar::positions_at(intercept + i, slope + i, n - i, t, out + i);
+        }
+
+        __attribute__((target("avx2")))
+        inline int min_position_at(const int* intercept, const int* slope, size_t n, int t) {
+            __m256i time = _mm256_set1_epi32(t);
+            __m256i best = _mm256_set1_epi32(std::numeric_limits<int>::max());
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(intercept + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slope + i));
+                best = _mm256_min_epi32(best, _mm256_add_epi32(a, _mm256_mullo_epi32(b, time)));
+            }
+            alignas(32) int lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+            int result = scalar::min_position_at(intercept + i, slope + i, n - i, t);
+            for (int lane : lanes)
+                result = std::min(result, lane);
+            return result;
+        }
+
+        __attribute__((target("avx2")))
+        inline void failure_times(const int* interceptA, const int* slopeA, const int* interceptB, const int* slopeB,
+                                  size_t n, double* out) {
+            __m256d never = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+            __m256d zero = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256d ia = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(interceptA + i)));
+                __m256d sa = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(slopeA + i)));
+                __m256d ib = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(interceptB + i)));
+                __m256d sb = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(slopeB + i)));
+                __m256d denominator = _mm256_sub_pd(sa, sb);
+                __m256d time = _mm256_div_pd(_mm256_sub_pd(ib, ia), denominator);
+                __m256d converging = _mm256_cmp_pd(denominator, zero, _CMP_GT_OQ);
+                _mm256_storeu_pd(out + i, _mm256_blendv_pd(never, time, converging));
+            }
+            scalar::failure_times(interceptA + i, slopeA + i, interceptB + i, slopeB + i, n - i, out + i);
+        }
+    }
+
+    namespace sse41 {
+        __attribute__((target("sse4.1")))
+        inline void positions_at(const int* intercept, const int* slope, size_t n, int t, int* out) {
+            __m128i time = _mm_set1_epi32(t);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(intercept + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slope + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi32(a, _mm_mullo_epi32(b, time)));
+            }
+            scalar::positions_at(intercept + i, slope + i, n - i, t, out + i);
+        }
+
+        __attribute__((target("sse4.1")))
+        inline int min_position_at(const int* intercept, const int* slope, size_t n, int t) {
+            __m128i time = _mm_set1_epi32(t);
+            __m128i best = _mm_set1_epi32(std::numeric_limits<int>::max());
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(intercept + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slope + i));
+                best = _mm_min_epi32(best, _mm_add_epi32(a, _mm_mullo_epi32(b, time)));
+            }
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), best);
+            int result = scalar::min_position_at(intercept + i, slope + i, n - i, t);
+            for (int lane : lanes)
+                result = std::min(result, lane);
+            return result;
+        }
+
+        __attribute__((target("sse4.1")))
+        inline void failure_times(const int* interceptA, const int* slopeA, const int* interceptB, const int* slopeB,
+                                  size_t n, double* out) {
+            __m128d never = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+            __m128d zero = _mm_setzero_pd();
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                __m128d ia = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(interceptA + i)));
+                __m128d sa = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(slopeA + i)));
+                __m128d ib = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(interceptB + i)));
+                __m128d sb = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(slopeB + i)));
+                __m128d denominator = _mm_sub_pd(sa, sb);
+                __m128d time = _mm_div_pd(_mm_sub_pd(ib, ia), denominator);
+                _mm_storeu_pd(out + i, _mm_blendv_pd(never, time, _mm_cmpgt_pd(denominator, zero)));
+            }
+            scalar::failure_times(interceptA + i, slopeA + i, interceptB + i, slopeB + i, n - i, out + i);
+        }
+    }
+#endif
+
+    enum class Level { Scalar, SSE41, AVX2 };
+
+    // Whether the CPU can run the kernels of a level
+    inline bool supported(Level level) {
+#ifdef KINETIC_X86_KERNELS
+        __builtin_cpu_init();
+        if (level == Level::AVX2)
+            return __builtin_cpu_supports("avx2");
+        if (level == Level::SSE41)
+            return __builtin_cpu_supports("sse4.1");
+#endif
+        return level == Level::Scalar;
+    }
+
+    inline Level detect() {
+        for (Level level : { Level::AVX2, Level::SSE41 })
+            if (supported(level))
+                return level;
+        return Level::Scalar;
+    }
+
+    // The instruction set the dispatching kernels below use, detected once
+    inline Level level() {
+        static const Level detected = detect();
+        return detected;
+    }
+
+    // The kernels of a given level, which must be supported
+    inline void positions_at(Level level, const int* intercept, const int* slope, size_t n, int t, int* out) {
+#ifdef KINETIC_X86_KERNELS
+        if (level == Level::AVX2)
+            return avx2::positions_at(intercept, slope, n, t, out);
+        if (level == Level::SSE41)
+            return sse41::positions_at(intercept, slope, n, t, out);
+#endif
+        scalar::positions_at(intercept, slope, n, t, out);
+    }
+
+    inline int min_position_at(Level level, const int* intercept, const int* slope, size_t n, int t) {
+#ifdef KINETIC_X86_KERNELS
+        if (level == Level::AVX2)
+            return avx2::min_position_at(intercept, slope, n, t);
+        if (level == Level::SSE41)
+            return sse41::min_position_at(intercept, slope, n, t);
+#endif
+        return scalar::min_position_at(intercept, slope, n, t);
+    }
+
+    inline void failure_times(Level level, const int* interceptA, const int* slopeA, const int* interceptB, const int* slopeB,
+                              size_t n, double* out) {
+#ifdef KINETIC_X86_KERNELS
+        if (level == Level::AVX2)
+            return avx2::failure_times(interceptA, slopeA, interceptB, slopeB, n, out);
+        if (level == Level::SSE41)
+            return sse41::failure_times(interceptA, slopeA, interceptB, slopeB, n, out);
+#endif
+        scalar::failure_times(interceptA, slopeA, interceptB, slopeB, n, out);
+    }
+
+    inline void positions_at(const int* intercept, const int* slope, size_t n, int t, int* out) {
+        positions_at(level(), intercept, slope, n, t, out);
+    }
+
+    inline int min_position_at(const int* intercept, const int* slope, size_t n, int t) {
+        return min_position_at(level(), intercept, slope, n, t);
+    }
+
+    inline void failure_times(const int* interceptA, const int* slopeA, const int* interceptB, const int* slopeB,
+                              size_t n, double* out) {
+        failure_times(level(), interceptA, slopeA, interceptB, slopeB, n, out);
+    }
+}
+
+// Structure-of-arrays copy of a list of trajectories, for the kernels in simd.
+struct TrajectoryStore {
+    std::vector<int> intercepts;
+    std::vector<int> slopes;
+    std::vector<uint32_t> ids;
+
+    TrajectoryStore() {}
+
+    // Copies trajectories[begin, end)
+    template<typename Iterator>
+    TrajectoryStore(Iterator begin, Iterator end) {
+        assign(begin, end);
+    }
+
+    template<typename Iterator>
+    void assign(Iterator begin, Iterator end) {
+        size_t n = std::distance(begin, end);
+        intercepts.resize(n);
+        slopes.resize(n);
+        ids.resize(n);
+        for (size_t i = 0; i < n; ++i, ++begin) {
+            const Trajectory& trajectory = *begin;
+            intercepts[i] = trajectory.intercept;
+            slopes[i] = trajectory.slope;
+            ids[i] = trajectory.id;
+        }
+    }
+
+    void reserve(size_t n) {
+        intercepts.reserve(n);
+        slopes.reserve(n);
+        ids.reserve(n);
+    }
+
+    void resize(size_t n) {
+        intercepts.resize(n);
+        slopes.resize(n);
+        ids.resize(n);
+    }
+
+    void push_back(const Trajectory& trajectory) {
+        intercepts.push_back(trajectory.intercept);
+        slopes.push_back(trajectory.slope);
+        ids.push_back(trajectory.id);
+    }
+
+    void set(size_t i, const Trajectory& trajectory) {
+        intercepts[i] = trajectory.intercept;
+        slopes[i] = trajectory.slope;
+        ids[i] = trajectory.id;
+    }
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    void positions_at(int t, int* out) const {
+        simd::positions_at(intercepts.data(), slopes.data(), size(), t, out);
+    }
+
+    int min_position_at(int t) const {
+        return simd::min_position_at(intercepts.data(), slopes.data(), size(), t);
+    }
+
+    // out[i] is the failure time of the certificate that trajectory i comes before trajectory i + 1,
+    // or -infinity if they're moving apart. out needs room for size() - 1 values.
+    void neighbour_failure_times(double* out) const {
+        if (size() > 1)
+            simd::failure_times(intercepts.data(), slopes.data(), intercepts.data() + 1, slopes.data() + 1, size() - 1, out);
+    }
+
+    // Same for the pairs (i, i + 1) with i in [begin, end), written to out[begin, end)
+    void neighbour_failure_times(size_t begin, size_t end, double* out) const {
+        simd::failure_times(intercepts.data() + begin, slopes.data() + begin,
+                            intercepts.data() + begin + 1, slopes.data() + begin + 1, end - begin, out + begin);
+    }
+};